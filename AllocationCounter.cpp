@@ -0,0 +1,73 @@
+#include "AllocationCounter.hpp"
+
+#include "imgui.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_allocationCount{0};
+
+static void *allocate(size_t size, size_t alignment)
+{
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (!size)
+    {
+        size = 1;
+    }
+    if (alignment <= alignof(std::max_align_t))
+    {
+        return malloc(size);
+    }
+    // aligned_alloc requires a size that is a multiple of the alignment
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *operator new(size_t size)
+{
+    if (const auto ptr = allocate(size, alignof(std::max_align_t)))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (const auto ptr = allocate(size, static_cast<size_t>(alignment)))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+static void *imgui_alloc(size_t size, void *)
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+static void imgui_free(void *ptr, void *)
+{
+    free(ptr);
+}
+
+uint64_t allocation_count()
+{
+    return s_allocationCount.load(std::memory_order_relaxed);
+}
+
+void count_imgui_allocations()
+{
+    ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made through the global operator new since startup, plus
+// those made by ImGui once count_imgui_allocations() has been called. Counts
+// from every thread.
+uint64_t allocation_count();
+void count_imgui_allocations();
@@ -0,0 +1,85 @@
+#include "CallCounter.hpp"
+
+#include "Trace.hpp"
+
+static std::atomic<bool> s_enabled{false};
+static std::array<std::atomic<uint32_t>, CallCounter::CALL_COUNT> s_frameCounts;
+static std::array<std::atomic<uint32_t>, CallCounter::CALL_COUNT> s_lastFrameCounts;
+
+void CallCounter::SetEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool CallCounter::IsEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+void CallCounter::add(Call call, uint32_t count)
+{
+    s_frameCounts[static_cast<size_t>(call)].fetch_add(count, std::memory_order_relaxed);
+}
+
+void CallCounter::FrameEnded()
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < CALL_COUNT; ++i)
+    {
+        const auto count = s_frameCounts[i].exchange(0, std::memory_order_relaxed);
+        s_lastFrameCounts[i].store(count, std::memory_order_relaxed);
+        Trace::AddCounter(Name(static_cast<Call>(i)), now, count);
+    }
+}
+
+CallCounter::Counts CallCounter::LastFrame()
+{
+    Counts counts;
+    for (size_t i = 0; i < CALL_COUNT; ++i)
+    {
+        counts[i] = s_lastFrameCounts[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+const char *CallCounter::Name(Call call)
+{
+    switch (call)
+    {
+    case Call::SetViewport:
+        return "vkCmdSetViewport";
+    case Call::SetScissor:
+        return "vkCmdSetScissor";
+    case Call::BindPipeline:
+        return "vkCmdBindPipeline";
+    case Call::BindDescriptorSets:
+        return "vkCmdBindDescriptorSets";
+    case Call::BindIndexBuffer:
+        return "vkCmdBindIndexBuffer";
+    case Call::BindVertexBuffers:
+        return "vkCmdBindVertexBuffers";
+    case Call::PushConstants:
+        return "vkCmdPushConstants";
+    case Call::DrawIndexed:
+        return "vkCmdDrawIndexed";
+    case Call::ExecuteCommands:
+        return "vkCmdExecuteCommands";
+    case Call::QueueSubmit:
+        return "vkQueueSubmit";
+    case Call::QueuePresent:
+        return "vkQueuePresentKHR";
+    case Call::MapMemory:
+        return "vmaMapMemory";
+    case Call::UnmapMemory:
+        return "vmaUnmapMemory";
+    case Call::FlushAllocation:
+        return "vmaFlushAllocation";
+    default:
+        return "Unknown";
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Process-wide counts of the Vulkan and VMA calls made per frame, to verify
+// batching and catch changes that quietly add calls. Counting is off until
+// SetEnabled, and a disabled Add costs one relaxed load.
+class CallCounter
+{
+public:
+    enum class Call
+    {
+        SetViewport,
+        SetScissor,
+        BindPipeline,
+        BindDescriptorSets,
+        BindIndexBuffer,
+        BindVertexBuffers,
+        PushConstants,
+        DrawIndexed,
+        ExecuteCommands,
+        QueueSubmit,
+        QueuePresent,
+        MapMemory,
+        UnmapMemory,
+        FlushAllocation,
+        Count
+    };
+
+    static constexpr size_t CALL_COUNT = static_cast<size_t>(Call::Count);
+    using Counts = std::array<uint32_t, CALL_COUNT>;
+
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    static void Add(Call call, uint32_t count = 1)
+    {
+        if (IsEnabled())
+        {
+            add(call, count);
+        }
+    }
+
+    // Called once per presented frame, publishes the counts of the frame and
+    // adds them to the Trace while one is recording
+    static void FrameEnded();
+    // Counts of the most recently ended frame
+    static Counts LastFrame();
+    static const char *Name(Call call);
+
+private:
+    static void add(Call call, uint32_t count);
+};
+
+// Static dispatcher that counts the commands it forwards. Pass it as the
+// dispatch argument of vulkan.hpp calls that should be counted.
+struct CountingDispatch : vk::DispatchLoaderStatic
+{
+    void vkCmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount, const VkViewport *pViewports) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::SetViewport);
+        ::vkCmdSetViewport(commandBuffer, firstViewport, viewportCount, pViewports);
+    }
+
+    void vkCmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D *pScissors) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::SetScissor);
+        ::vkCmdSetScissor(commandBuffer, firstScissor, scissorCount, pScissors);
+    }
+
+    void vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::BindPipeline);
+        ::vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+    }
+
+    void vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet *pDescriptorSets, uint32_t dynamicOffsetCount, const uint32_t *pDynamicOffsets) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::BindDescriptorSets);
+        ::vkCmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+    }
+
+    void vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::BindIndexBuffer);
+        ::vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+    }
+
+    void vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer *pBuffers, const VkDeviceSize *pOffsets) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::BindVertexBuffers);
+        ::vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+    }
+
+    void vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void *pValues) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::PushConstants);
+        ::vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, pValues);
+    }
+
+    void vkCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::DrawIndexed);
+        ::vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    }
+
+    void vkCmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::ExecuteCommands);
+        ::vkCmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+    }
+
+    VkResult vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits, VkFence fence) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::QueueSubmit);
+        return ::vkQueueSubmit(queue, submitCount, pSubmits, fence);
+    }
+
+    VkResult vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) const VULKAN_HPP_NOEXCEPT
+    {
+        CallCounter::Add(CallCounter::Call::QueuePresent);
+        return ::vkQueuePresentKHR(queue, pPresentInfo);
+    }
+};
+
+inline const CountingDispatch COUNTING_DISPATCH{};
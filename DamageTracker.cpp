@@ -0,0 +1,105 @@
+#include "DamageTracker.hpp"
+
+#include "DrawDataHash.hpp"
+
+vk::Rect2D framebuffer_clip_rect(const ImDrawData *pDD, const ImVec4& clipRect, vk::Extent2D framebufferExtent)
+{
+    const auto x0 = static_cast<int32_t>((clipRect.x - pDD->DisplayPos.x) * pDD->FramebufferScale.x);
+    const auto y0 = static_cast<int32_t>((clipRect.y - pDD->DisplayPos.y) * pDD->FramebufferScale.y);
+    const auto x1 = static_cast<int32_t>((clipRect.z - pDD->DisplayPos.x) * pDD->FramebufferScale.x);
+    const auto y1 = static_cast<int32_t>((clipRect.w - pDD->DisplayPos.y) * pDD->FramebufferScale.y);
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return {};
+    }
+
+    const auto rect = vk::Rect2D{{x0, y0}, {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}};
+    return intersect_rects(rect, {{}, framebufferExtent});
+}
+
+DamageTracker::DamageTracker()
+    :frameCount(0)
+{
+
+}
+
+uint64_t DamageTracker::update(const ImDrawData *pDD, vk::Extent2D framebufferExtent)
+{
+    std::swap(previousLists, currentLists);
+    currentLists.resize(pDD->CmdListsCount);
+
+    for (int i = 0; i < pDD->CmdListsCount; ++i)
+    {
+        const auto pCL = pDD->CmdLists[i];
+        auto& state = currentLists[i];
+
+        Hasher hasher;
+        hash_draw_list(hasher, pCL);
+        state.hash = hasher.finish();
+
+        state.bounds = vk::Rect2D();
+        for (const auto& drawCommand : pCL->CmdBuffer)
+        {
+            state.bounds = union_rects(state.bounds, framebuffer_clip_rect(pDD, drawCommand.ClipRect, framebufferExtent));
+        }
+    }
+
+    vk::Rect2D damage;
+    const auto geometryChanged = framebufferExtent != extent || pDD->DisplayPos.x != displayPos.x || pDD->DisplayPos.y != displayPos.y || pDD->DisplaySize.x != displaySize.x || pDD->DisplaySize.y != displaySize.y;
+    if (geometryChanged)
+    {
+        damage = vk::Rect2D({}, framebufferExtent);
+    }
+    else
+    {
+        // Lists are matched by position, reordered windows simply damage both places
+        const auto commonCount = std::min(previousLists.size(), currentLists.size());
+        for (size_t i = 0; i < commonCount; ++i)
+        {
+            const auto& previous = previousLists[i];
+            const auto& current = currentLists[i];
+            if (previous.hash != current.hash || previous.bounds != current.bounds)
+            {
+                damage = union_rects(damage, union_rects(previous.bounds, current.bounds));
+            }
+        }
+        for (size_t i = commonCount; i < previousLists.size(); ++i)
+        {
+            damage = union_rects(damage, previousLists[i].bounds);
+        }
+        for (size_t i = commonCount; i < currentLists.size(); ++i)
+        {
+            damage = union_rects(damage, currentLists[i].bounds);
+        }
+    }
+
+    extent = framebufferExtent;
+    displayPos = pDD->DisplayPos;
+    displaySize = pDD->DisplaySize;
+
+    ++frameCount;
+    history[frameCount % HISTORY_SIZE] = damage;
+    return frameCount;
+}
+
+vk::Rect2D DamageTracker::damageSince(uint64_t frame) const
+{
+    if (!frame || frame > frameCount || frameCount - frame >= HISTORY_SIZE)
+    {
+        return {{}, extent};
+    }
+
+    vk::Rect2D damage;
+    for (auto i = frame + 1; i <= frameCount; ++i)
+    {
+        damage = union_rects(damage, history[i % HISTORY_SIZE]);
+    }
+    return damage;
+}
+
+void DamageTracker::reset()
+{
+    previousLists.clear();
+    currentLists.clear();
+    extent = vk::Extent2D();
+}
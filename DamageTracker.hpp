@@ -0,0 +1,42 @@
+#pragma once
+
+#include "RendererUtil.hpp"
+
+#include "imgui.h"
+
+// Transforms an ImDrawCmd clip rectangle into framebuffer pixels, clamped to the framebuffer
+vk::Rect2D framebuffer_clip_rect(const ImDrawData *pDD, const ImVec4& clipRect, vk::Extent2D framebufferExtent);
+
+// Diffs each frame's draw lists against the previous frame to find the region
+// of the framebuffer that changed. Swapchain images hold the contents of
+// whichever frame last rendered into them, so damage is kept for a few frames
+// and accumulated per image by damageSince().
+class DamageTracker
+{
+public:
+    DamageTracker();
+
+    // Returns the serial of the frame just tracked
+    uint64_t update(const ImDrawData *pDD, vk::Extent2D framebufferExtent);
+    // Union of everything that changed after the given frame, the whole
+    // framebuffer if that frame is unknown or too old
+    vk::Rect2D damageSince(uint64_t frame) const;
+    void reset();
+
+private:
+    struct DrawListState
+    {
+        uint64_t hash;
+        vk::Rect2D bounds;
+    };
+
+    static constexpr size_t HISTORY_SIZE = 8;
+
+private:
+    vk::Extent2D extent;
+    ImVec2 displayPos, displaySize;
+    std::vector<DrawListState> previousLists, currentLists;
+
+    uint64_t frameCount;
+    std::array<vk::Rect2D, HISTORY_SIZE> history;
+};
@@ -0,0 +1,59 @@
+#include "DebugUtils.hpp"
+
+DebugUtils::DebugUtils()
+    :pfnSetObjectName(nullptr), pfnBeginLabel(nullptr), pfnEndLabel(nullptr)
+{
+
+}
+
+void DebugUtils::init(vk::Instance instance, vk::Device device)
+{
+    this->device = device;
+
+    // Static dispatch only covers core entry points, and the labels are recorded
+    // in every frame, so the extension's are resolved once here
+    pfnSetObjectName = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(instance.getProcAddr("vkSetDebugUtilsObjectNameEXT"));
+    pfnBeginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(instance.getProcAddr("vkCmdBeginDebugUtilsLabelEXT"));
+    pfnEndLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(instance.getProcAddr("vkCmdEndDebugUtilsLabelEXT"));
+
+    if (!pfnSetObjectName || !pfnBeginLabel || !pfnEndLabel)
+    {
+        pfnSetObjectName = nullptr;
+        pfnBeginLabel = nullptr;
+        pfnEndLabel = nullptr;
+    }
+}
+
+bool DebugUtils::enabled() const
+{
+    return pfnSetObjectName;
+}
+
+void DebugUtils::beginLabel(vk::CommandBuffer commandBuffer, const char *pName) const
+{
+    if (!pfnBeginLabel)
+    {
+        return;
+    }
+
+    const auto label = vk::DebugUtilsLabelEXT()
+        .setPLabelName(pName);
+    pfnBeginLabel(commandBuffer, reinterpret_cast<const VkDebugUtilsLabelEXT *>(&label));
+}
+
+void DebugUtils::endLabel(vk::CommandBuffer commandBuffer) const
+{
+    if (pfnEndLabel)
+    {
+        pfnEndLabel(commandBuffer);
+    }
+}
+
+void DebugUtils::set_object_name(vk::ObjectType objectType, uint64_t handle, const char *pName) const
+{
+    const auto nameInfo = vk::DebugUtilsObjectNameInfoEXT()
+        .setObjectType(objectType)
+        .setObjectHandle(handle)
+        .setPObjectName(pName);
+    pfnSetObjectName(device, reinterpret_cast<const VkDebugUtilsObjectNameInfoEXT *>(&nameInfo));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdio>
+
+// VK_EXT_debug_utils object names and command buffer labels for capture tools
+// and external GPU profilers. Every call returns right away unless init found
+// the extension enabled, so callers never need to check.
+class DebugUtils
+{
+public:
+    static constexpr const char *EXTENSION_NAME = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+
+    DebugUtils();
+
+    // The instance must have been created with EXTENSION_NAME enabled
+    void init(vk::Instance instance, vk::Device device);
+    bool enabled() const;
+
+    // Works with any vulkan.hpp handle, pFormat is a printf format
+    template<typename T, typename... Args>
+    void setName(T handle, const char *pFormat, Args... args) const
+    {
+        if (!pfnSetObjectName)
+        {
+            return;
+        }
+
+        char name[128];
+        snprintf(name, sizeof(name), pFormat, args...);
+        set_object_name(T::objectType, uint64_t(static_cast<typename T::CType>(handle)), name);
+    }
+
+    void beginLabel(vk::CommandBuffer commandBuffer, const char *pName) const;
+    void endLabel(vk::CommandBuffer commandBuffer) const;
+
+private:
+    void set_object_name(vk::ObjectType objectType, uint64_t handle, const char *pName) const;
+
+private:
+    vk::Device device;
+    PFN_vkSetDebugUtilsObjectNameEXT pfnSetObjectName;
+    PFN_vkCmdBeginDebugUtilsLabelEXT pfnBeginLabel;
+    PFN_vkCmdEndDebugUtilsLabelEXT pfnEndLabel;
+};
@@ -0,0 +1,14 @@
+#include "DeletionQueue.hpp"
+
+void DeletionQueue::collect(uint64_t completedSerial)
+{
+    while (!entries.empty() && entries.front().first <= completedSerial)
+    {
+        entries.pop_front();
+    }
+}
+
+bool DeletionQueue::empty() const
+{
+    return entries.empty();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+// Keeps objects alive until the GPU finished the submission serial they were
+// retired with, so their owners can move on without waiting for the GPU.
+class DeletionQueue
+{
+public:
+    template<typename T>
+    void retire(uint64_t serial, T&& object)
+    {
+        entries.emplace_back(serial, std::make_shared<std::decay_t<T>>(std::forward<T>(object)));
+    }
+
+    // Destroys everything retired with a serial up to completedSerial, oldest first
+    void collect(uint64_t completedSerial);
+    bool empty() const;
+
+private:
+    std::deque<std::pair<uint64_t, std::shared_ptr<void>>> entries;
+};
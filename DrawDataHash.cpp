@@ -0,0 +1,100 @@
+#include "DrawDataHash.hpp"
+
+#include "imgui.h"
+
+#include <cstring>
+
+constexpr uint32_t PRIME1 = 0x9E3779B1u;
+constexpr uint32_t PRIME2 = 0x85EBCA77u;
+constexpr uint32_t PRIME3 = 0xC2B2AE3Du;
+constexpr size_t LANE_COUNT = 8;
+constexpr size_t BLOCK_SIZE = LANE_COUNT * sizeof(uint32_t);
+
+static constexpr uint32_t rotl(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+Hasher::Hasher()
+    :totalSize(0)
+{
+    for (size_t i = 0; i < LANE_COUNT; ++i)
+    {
+        lanes[i] = PRIME1 + static_cast<uint32_t>(i) * PRIME2;
+    }
+}
+
+void Hasher::update(const void *pData, size_t size)
+{
+    const auto pBytes = static_cast<const uint8_t *>(pData);
+    totalSize += size;
+
+    size_t offset = 0;
+    for (; offset + BLOCK_SIZE <= size; offset += BLOCK_SIZE)
+    {
+        uint32_t block[LANE_COUNT];
+        memcpy(block, pBytes + offset, BLOCK_SIZE);
+        for (size_t i = 0; i < LANE_COUNT; ++i)
+        {
+            lanes[i] = rotl(lanes[i] + block[i] * PRIME2, 13) * PRIME1;
+        }
+    }
+
+    if (offset < size)
+    {
+        uint32_t block[LANE_COUNT] = { };
+        memcpy(block, pBytes + offset, size - offset);
+        for (size_t i = 0; i < LANE_COUNT; ++i)
+        {
+            lanes[i] = rotl(lanes[i] + block[i] * PRIME3, 17) * PRIME1;
+        }
+    }
+}
+
+uint64_t Hasher::finish() const
+{
+    uint64_t low = totalSize, high = totalSize >> 32;
+    for (size_t i = 0; i < LANE_COUNT; i += 2)
+    {
+        low = (low ^ rotl(lanes[i], static_cast<int>(i) + 1)) * PRIME1;
+        high = (high ^ rotl(lanes[i + 1], static_cast<int>(i) + 2)) * PRIME2;
+    }
+
+    auto hash = (high << 32) ^ low;
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+void hash_draw_list(Hasher& hasher, const ImDrawList *pCL)
+{
+    hasher.update(pCL->VtxBuffer.Data, pCL->VtxBuffer.size_in_bytes());
+    hasher.update(pCL->IdxBuffer.Data, pCL->IdxBuffer.size_in_bytes());
+
+    for (const auto& drawCommand : pCL->CmdBuffer)
+    {
+        // Hashed field by field, ImDrawCmd may contain padding
+        hasher.update(drawCommand.ClipRect);
+        hasher.update(drawCommand.TextureId);
+        hasher.update(drawCommand.VtxOffset);
+        hasher.update(drawCommand.IdxOffset);
+        hasher.update(drawCommand.ElemCount);
+    }
+}
+
+uint64_t hash_draw_data(const ImDrawData *pDD)
+{
+    Hasher hasher;
+    hasher.update(pDD->DisplayPos);
+    hasher.update(pDD->DisplaySize);
+    hasher.update(pDD->FramebufferScale);
+    hasher.update(pDD->CmdListsCount);
+
+    for (int i = 0; i < pDD->CmdListsCount; ++i)
+    {
+        hash_draw_list(hasher, pDD->CmdLists[i]);
+    }
+
+    return hasher.finish();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct ImDrawData;
+struct ImDrawList;
+
+// Eight independent 32-bit multiply-rotate lanes over 32-byte blocks, laid out
+// so compilers can keep all lanes in one vector register. Not stable across
+// versions, only meant to compare frames within one process.
+class Hasher
+{
+public:
+    Hasher();
+
+    void update(const void *pData, size_t size);
+    uint64_t finish() const;
+
+    template<typename T>
+    void update(const T& value)
+    {
+        update(&value, sizeof(value));
+    }
+
+private:
+    std::array<uint32_t, 8> lanes;
+    uint64_t totalSize;
+};
+
+// Covers vertex and index bytes and every draw command
+void hash_draw_list(Hasher& hasher, const ImDrawList *pCL);
+// Covers every draw list and the display geometry
+uint64_t hash_draw_data(const ImDrawData *pDD);
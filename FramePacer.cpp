@@ -0,0 +1,50 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <thread>
+
+constexpr int SMOOTHING = 8;
+constexpr auto MIN_SAFETY_MARGIN = std::chrono::milliseconds(1);
+
+static std::chrono::nanoseconds smooth(std::chrono::nanoseconds average, std::chrono::nanoseconds sample)
+{
+    return average.count() ? average + (sample - average) / SMOOTHING : sample;
+}
+
+FramePacer::FramePacer()
+    :period(0), work(0)
+{
+
+}
+
+void FramePacer::frameBegun()
+{
+    const auto now = Clock::now();
+    if (lastBegin.time_since_epoch().count())
+    {
+        period = smooth(period, std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastBegin));
+    }
+    lastBegin = now;
+}
+
+void FramePacer::waitForInputDeadline() const
+{
+    // An image that just became available is presented one period later at
+    // the earliest, so input only has to be ready by then minus the work
+    const auto margin = std::max<std::chrono::nanoseconds>(MIN_SAFETY_MARGIN, work / 4);
+    const auto slack = period - work - margin;
+    if (slack.count() > 0)
+    {
+        std::this_thread::sleep_until(lastBegin + slack);
+    }
+}
+
+void FramePacer::inputSampled()
+{
+    inputTime = Clock::now();
+}
+
+void FramePacer::frameSubmitted()
+{
+    work = smooth(work, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - inputTime));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+
+// Predicts how late input can be sampled after a frame slot and swapchain
+// image were acquired, so that building the UI and recording finish just
+// before the image can next be presented.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer();
+
+    // Call right after Renderer::beginFrame succeeded
+    void frameBegun();
+    // Sleeps until the predicted latest moment to sample input
+    void waitForInputDeadline() const;
+    void inputSampled();
+    void frameSubmitted();
+
+private:
+    Clock::time_point lastBegin, inputTime;
+    // Smoothed interval between acquired images and CPU time from input to submit
+    std::chrono::nanoseconds period, work;
+};
@@ -0,0 +1,290 @@
+#include "GpuProfiler.hpp"
+
+#include "Profiler.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// What std::chrono::steady_clock reads on Linux
+constexpr auto HOST_TIME_DOMAIN = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+// Results are written in bit order, matching PipelineStatistics
+constexpr auto PIPELINE_STATISTICS = vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices
+    | vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives
+    | vk::QueryPipelineStatisticFlagBits::eClippingPrimitives
+    | vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+double GpuProfiler::FrameStatistics::overdraw() const
+{
+    return framebufferPixels ? static_cast<double>(total.fragmentInvocations) / framebufferPixels : 0.0;
+}
+
+GpuProfiler::GpuProfiler()
+    :pAllocationCallbacks(nullptr), timestampPeriod(0.0f), timestamps(false), pipelineStatistics(false), pfnGetCalibratedTimestamps(nullptr), hostOffset(0.0), hostOffsetValid(false), lastStatistics{}
+{
+
+}
+
+void GpuProfiler::init(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, uint32_t queueFamilyIndex, uint32_t frameCount, bool timestamps, bool pipelineStatistics, bool calibratedTimestamps)
+{
+    this->device = device;
+    this->pAllocationCallbacks = pAllocationCallbacks;
+
+    const auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+    timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+    this->timestamps = timestamps && queueFamilies[queueFamilyIndex].timestampValidBits != 0;
+    this->pipelineStatistics = pipelineStatistics;
+
+    const auto pfnGetTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(instance.getProcAddr("vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+    if (this->timestamps && calibratedTimestamps && pfnGetTimeDomains)
+    {
+        uint32_t timeDomainCount = 0;
+        pfnGetTimeDomains(physicalDevice, &timeDomainCount, nullptr);
+        std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+        pfnGetTimeDomains(physicalDevice, &timeDomainCount, timeDomains.data());
+
+        const auto has_domain = [&timeDomains](VkTimeDomainEXT domain) {
+            return std::find(timeDomains.begin(), timeDomains.end(), domain) != timeDomains.end();
+        };
+        if (has_domain(VK_TIME_DOMAIN_DEVICE_EXT) && has_domain(HOST_TIME_DOMAIN))
+        {
+            pfnGetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(device.getProcAddr("vkGetCalibratedTimestampsEXT"));
+        }
+    }
+
+    resize(frameCount);
+}
+
+void GpuProfiler::resize(uint32_t frameCount)
+{
+    if (!timestamps && !pipelineStatistics)
+    {
+        return;
+    }
+
+    const auto oldFrameCount = perFrameData.size();
+    perFrameData.resize(frameCount);
+
+    for (size_t i = oldFrameCount; i < perFrameData.size(); ++i)
+    {
+        auto& perFrame = perFrameData[i];
+
+        if (timestamps)
+        {
+            const auto queryPoolCreateInfo = vk::QueryPoolCreateInfo()
+                .setQueryType(vk::QueryType::eTimestamp)
+                .setQueryCount(TIMESTAMP_COUNT);
+            perFrame.timestampPool = device.createQueryPoolUnique(queryPoolCreateInfo, pAllocationCallbacks);
+        }
+
+        if (pipelineStatistics)
+        {
+            const auto queryPoolCreateInfo = vk::QueryPoolCreateInfo()
+                .setQueryType(vk::QueryType::ePipelineStatistics)
+                .setQueryCount(MAX_TIMED_DRAW_LISTS)
+                .setPipelineStatistics(PIPELINE_STATISTICS);
+            perFrame.statisticsPool = device.createQueryPoolUnique(queryPoolCreateInfo, pAllocationCallbacks);
+        }
+
+        perFrame.drawListCount = 0;
+        perFrame.framebufferPixels = 0;
+        perFrame.pending = false;
+    }
+}
+
+bool GpuProfiler::timestampsEnabled() const
+{
+    return timestamps;
+}
+
+bool GpuProfiler::pipelineStatisticsEnabled() const
+{
+    return pipelineStatistics;
+}
+
+void GpuProfiler::collect(uint32_t frameIndex)
+{
+    if (perFrameData.empty() || !perFrameData[frameIndex].pending)
+    {
+        return;
+    }
+    auto& perFrame = perFrameData[frameIndex];
+    perFrame.pending = false;
+
+    if (timestamps)
+    {
+        collect_timestamps(perFrame);
+    }
+    if (pipelineStatistics)
+    {
+        collect_statistics(perFrame);
+    }
+}
+
+const GpuProfiler::FrameStatistics& GpuProfiler::lastFrameStatistics() const
+{
+    return lastStatistics;
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawListCount, vk::Extent2D framebufferExtent)
+{
+    if (perFrameData.empty())
+    {
+        return;
+    }
+    auto& perFrame = perFrameData[frameIndex];
+    perFrame.drawListCount = std::min(drawListCount, MAX_TIMED_DRAW_LISTS);
+    perFrame.framebufferPixels = static_cast<uint64_t>(framebufferExtent.width) * framebufferExtent.height;
+    perFrame.pending = true;
+
+    if (timestamps)
+    {
+        commandBuffer.resetQueryPool(perFrame.timestampPool.get(), 0, TIMESTAMP_COUNT);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, perFrame.timestampPool.get(), FRAME_BEGIN);
+    }
+    if (pipelineStatistics)
+    {
+        commandBuffer.resetQueryPool(perFrame.statisticsPool.get(), 0, MAX_TIMED_DRAW_LISTS);
+    }
+}
+
+void GpuProfiler::endSubpass0(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (timestamps)
+    {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, perFrameData[frameIndex].timestampPool.get(), SUBPASS0_END);
+    }
+}
+
+void GpuProfiler::endFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (timestamps)
+    {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, perFrameData[frameIndex].timestampPool.get(), FRAME_END);
+    }
+}
+
+void GpuProfiler::beginDrawList(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawListIndex)
+{
+    if (drawListIndex >= MAX_TIMED_DRAW_LISTS)
+    {
+        return;
+    }
+
+    if (timestamps && drawListIndex == 0)
+    {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, perFrameData[frameIndex].timestampPool.get(), FIRST_DRAW_LIST);
+    }
+    // A frame-wide query can't overlap these, so frame totals are summed from the lists
+    if (pipelineStatistics)
+    {
+        commandBuffer.beginQuery(perFrameData[frameIndex].statisticsPool.get(), drawListIndex, {});
+    }
+}
+
+void GpuProfiler::endDrawList(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawListIndex)
+{
+    if (drawListIndex >= MAX_TIMED_DRAW_LISTS)
+    {
+        return;
+    }
+
+    if (pipelineStatistics)
+    {
+        commandBuffer.endQuery(perFrameData[frameIndex].statisticsPool.get(), drawListIndex);
+    }
+    if (timestamps)
+    {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, perFrameData[frameIndex].timestampPool.get(), FIRST_DRAW_LIST + drawListIndex + 1);
+    }
+}
+
+void GpuProfiler::collect_timestamps(const PerFrameData& perFrame)
+{
+    // FIRST_DRAW_LIST is only written when there are draw lists, reading it otherwise never becomes ready
+    const auto timestampCount = perFrame.drawListCount ? FIRST_DRAW_LIST + perFrame.drawListCount + 1 : FIRST_DRAW_LIST;
+    std::array<uint64_t, TIMESTAMP_COUNT> results;
+    // Not waiting, the slot's submission already completed
+    const auto result = device.getQueryPoolResults(perFrame.timestampPool.get(), 0, timestampCount, sizeof(uint64_t) * timestampCount, results.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+    {
+        return;
+    }
+
+    // Host time only matters to traces, don't pay for calibration otherwise
+    if (Trace::IsRecording())
+    {
+        update_host_offset(results[FRAME_END]);
+    }
+
+    const auto host_time = [this, &results](uint32_t index) {
+        return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(static_cast<int64_t>(results[index] * static_cast<double>(timestampPeriod) + hostOffset)));
+    };
+    const auto elapsed = [this, &results](uint32_t begin, uint32_t end) {
+        return std::chrono::nanoseconds(static_cast<int64_t>((results[end] - results[begin]) * timestampPeriod));
+    };
+
+    Profiler::Record(Profiler::Phase::GpuSubpass0, host_time(FRAME_BEGIN), elapsed(FRAME_BEGIN, SUBPASS0_END));
+    Profiler::Record(Profiler::Phase::GpuSubpass1, host_time(SUBPASS0_END), elapsed(SUBPASS0_END, FRAME_END));
+    for (uint32_t i = 0; i < perFrame.drawListCount; ++i)
+    {
+        Profiler::Record(Profiler::Phase::GpuDrawList, host_time(FIRST_DRAW_LIST + i), elapsed(FIRST_DRAW_LIST + i, FIRST_DRAW_LIST + i + 1));
+    }
+}
+
+void GpuProfiler::update_host_offset(uint64_t completedTimestamp)
+{
+    if (pfnGetCalibratedTimestamps)
+    {
+        const auto timestampInfos = std::array{
+            VkCalibratedTimestampInfoEXT{ VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr, VK_TIME_DOMAIN_DEVICE_EXT },
+            VkCalibratedTimestampInfoEXT{ VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr, HOST_TIME_DOMAIN }
+        };
+        std::array<uint64_t, 2> calibrated;
+        uint64_t maxDeviation;
+        if (pfnGetCalibratedTimestamps(device, static_cast<uint32_t>(timestampInfos.size()), timestampInfos.data(), calibrated.data(), &maxDeviation) == VK_SUCCESS)
+        {
+            hostOffset = calibrated[1] - calibrated[0] * static_cast<double>(timestampPeriod);
+            hostOffsetValid = true;
+            return;
+        }
+    }
+
+    // The frame already completed, so the timestamp was written before now.
+    // The smallest difference seen so far is the tightest estimate.
+    const auto now = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    const auto offset = now - completedTimestamp * static_cast<double>(timestampPeriod);
+    hostOffset = hostOffsetValid ? std::min(hostOffset, offset) : offset;
+    hostOffsetValid = true;
+}
+
+void GpuProfiler::collect_statistics(const PerFrameData& perFrame)
+{
+    if (!perFrame.drawListCount)
+    {
+        lastStatistics = {};
+        lastStatistics.framebufferPixels = perFrame.framebufferPixels;
+        return;
+    }
+
+    std::array<PipelineStatistics, MAX_TIMED_DRAW_LISTS> results;
+    const auto result = device.getQueryPoolResults(perFrame.statisticsPool.get(), 0, perFrame.drawListCount, sizeof(PipelineStatistics) * perFrame.drawListCount, results.data(), sizeof(PipelineStatistics), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+    {
+        return;
+    }
+
+    lastStatistics.total = {};
+    for (uint32_t i = 0; i < perFrame.drawListCount; ++i)
+    {
+        const auto& drawList = results[i];
+        lastStatistics.drawLists[i] = drawList;
+        lastStatistics.total.inputVertices += drawList.inputVertices;
+        lastStatistics.total.inputPrimitives += drawList.inputPrimitives;
+        lastStatistics.total.clippedPrimitives += drawList.clippedPrimitives;
+        lastStatistics.total.fragmentInvocations += drawList.fragmentInvocations;
+    }
+    lastStatistics.drawListCount = perFrame.drawListCount;
+    lastStatistics.framebufferPixels = perFrame.framebufferPixels;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <vector>
+
+// GPU timestamps around the subpasses of a frame and each ImDrawList's
+// draws, and optionally pipeline statistics per draw list. Every frame slot
+// owns its own query pools, so results are read back without waiting once
+// the slot's previous submission completed. Timings land in the Profiler
+// next to the CPU phases, with GPU ticks converted to host time so traces
+// line both up.
+class GpuProfiler
+{
+public:
+    // Draw lists past this many are drawn but not measured
+    static constexpr uint32_t MAX_TIMED_DRAW_LISTS = 64;
+
+    struct PipelineStatistics
+    {
+        uint64_t inputVertices, inputPrimitives, clippedPrimitives, fragmentInvocations;
+    };
+
+    struct FrameStatistics
+    {
+        PipelineStatistics total;
+        std::array<PipelineStatistics, MAX_TIMED_DRAW_LISTS> drawLists;
+        uint32_t drawListCount;
+        uint64_t framebufferPixels;
+
+        // Fragment shader invocations per framebuffer pixel
+        double overdraw() const;
+    };
+
+    GpuProfiler();
+
+    // Features the device doesn't support are left disabled. Pipeline
+    // statistics need the pipelineStatisticsQuery device feature enabled,
+    // calibration the VK_EXT_calibrated_timestamps device extension.
+    void init(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, uint32_t queueFamilyIndex, uint32_t frameCount, bool timestamps, bool pipelineStatistics, bool calibratedTimestamps);
+    // All frames using the query pools must have completed
+    void resize(uint32_t frameCount);
+    bool timestampsEnabled() const;
+    bool pipelineStatisticsEnabled() const;
+
+    // Call once the slot's previous submission completed
+    void collect(uint32_t frameIndex);
+    // Most recently collected frame, zeroed until one was
+    const FrameStatistics& lastFrameStatistics() const;
+
+    // Resets the slot's queries and marks the start of the frame, outside a render pass
+    void beginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawListCount, vk::Extent2D framebufferExtent);
+    void endSubpass0(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+    // After the render pass ended
+    void endFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+    // Bracket the draws of one draw list. Recorded into the reusable
+    // secondary, so they only depend on the slot and the list index.
+    void beginDrawList(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawListIndex);
+    void endDrawList(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t drawListIndex);
+
+private:
+    enum Timestamp : uint32_t
+    {
+        FRAME_BEGIN,
+        SUBPASS0_END,
+        FRAME_END,
+        // Draw list i starts at FIRST_DRAW_LIST + i and ends where i + 1 starts
+        FIRST_DRAW_LIST,
+        TIMESTAMP_COUNT = FIRST_DRAW_LIST + MAX_TIMED_DRAW_LISTS + 1
+    };
+
+    struct PerFrameData
+    {
+        vk::UniqueQueryPool timestampPool, statisticsPool;
+        // Measured by the frame in flight
+        uint32_t drawListCount;
+        uint64_t framebufferPixels;
+        bool pending;
+    };
+
+private:
+    void collect_timestamps(const PerFrameData& perFrame);
+    void update_host_offset(uint64_t completedTimestamp);
+    void collect_statistics(const PerFrameData& perFrame);
+
+private:
+    vk::Device device;
+    const vk::AllocationCallbacks *pAllocationCallbacks;
+    // Nanoseconds per tick
+    float timestampPeriod;
+    bool timestamps, pipelineStatistics;
+
+    // Host nanoseconds minus GPU nanoseconds
+    PFN_vkGetCalibratedTimestampsEXT pfnGetCalibratedTimestamps;
+    double hostOffset;
+    bool hostOffsetValid;
+
+    std::vector<PerFrameData> perFrameData;
+    FrameStatistics lastStatistics;
+};
@@ -0,0 +1,241 @@
+#include "HostAllocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+// The arena only has to hold the allocations of one command at a time
+constexpr size_t ARENA_SIZE = 64 * 1024;
+
+struct AllocationHeader
+{
+    size_t size;
+    // Distance from the start of the underlying block to the allocation
+    uint32_t offset;
+    uint8_t scope;
+    bool arena;
+};
+
+struct ScopeCounters
+{
+    std::atomic<uint64_t> calls, liveBytes;
+    std::atomic<uint64_t> frameCalls, frameBytes;
+    std::atomic<uint64_t> lastFrameCalls, lastFrameBytes;
+};
+
+// Command scope allocations are made and freed within one call, so each thread
+// can rewind its arena whenever nothing in it is live
+struct Arena
+{
+    std::unique_ptr<uint8_t[]> block;
+    size_t offset = 0;
+    uint32_t liveCount = 0;
+};
+
+static HostAllocator::Mode s_mode;
+static bool s_installed = false;
+static vk::AllocationCallbacks s_callbacks;
+static std::array<ScopeCounters, HostAllocator::SCOPE_COUNT> s_counters;
+static std::atomic<uint64_t> s_arenaOverflows{0};
+static thread_local Arena t_arena;
+
+static void record(VkSystemAllocationScope scope, int64_t bytes)
+{
+    auto& counters = s_counters[scope];
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    // Frees wrap around to a subtraction
+    counters.liveBytes.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+    counters.frameCalls.fetch_add(1, std::memory_order_relaxed);
+    if (bytes > 0)
+    {
+        counters.frameBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+static uint8_t *arena_allocate(size_t size)
+{
+    if (!t_arena.block)
+    {
+        t_arena.block = std::make_unique<uint8_t[]>(ARENA_SIZE);
+    }
+    if (t_arena.offset + size > ARENA_SIZE)
+    {
+        s_arenaOverflows.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    const auto pBlock = t_arena.block.get() + t_arena.offset;
+    t_arena.offset += size;
+    ++t_arena.liveCount;
+    return pBlock;
+}
+
+static void arena_free()
+{
+    if (!--t_arena.liveCount)
+    {
+        t_arena.offset = 0;
+    }
+}
+
+static AllocationHeader *header_of(void *pMemory)
+{
+    return static_cast<AllocationHeader *>(pMemory) - 1;
+}
+
+static void *VKAPI_PTR allocate(void *, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    alignment = std::max(alignment, alignof(AllocationHeader));
+    const auto blockSize = size + sizeof(AllocationHeader) + alignment - 1;
+
+    const auto useArena = s_mode == HostAllocator::Mode::Arena && scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND;
+    auto pBlock = useArena ? arena_allocate(blockSize) : nullptr;
+    const auto arena = pBlock != nullptr;
+    if (!arena)
+    {
+        pBlock = static_cast<uint8_t *>(malloc(blockSize));
+        if (!pBlock)
+        {
+            return nullptr;
+        }
+    }
+
+    const auto address = (reinterpret_cast<uintptr_t>(pBlock) + sizeof(AllocationHeader) + alignment - 1) & ~(alignment - 1);
+    const auto pMemory = reinterpret_cast<void *>(address);
+
+    auto& header = *header_of(pMemory);
+    header.size = size;
+    header.offset = static_cast<uint32_t>(address - reinterpret_cast<uintptr_t>(pBlock));
+    header.scope = static_cast<uint8_t>(scope);
+    header.arena = arena;
+
+    record(scope, static_cast<int64_t>(size));
+    return pMemory;
+}
+
+static void VKAPI_PTR free_memory(void *, void *pMemory)
+{
+    if (!pMemory)
+    {
+        return;
+    }
+
+    const auto& header = *header_of(pMemory);
+    record(static_cast<VkSystemAllocationScope>(header.scope), -static_cast<int64_t>(header.size));
+    if (header.arena)
+    {
+        arena_free();
+    }
+    else
+    {
+        free(static_cast<uint8_t *>(pMemory) - header.offset);
+    }
+}
+
+static void *VKAPI_PTR reallocate(void *pUserData, void *pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!pOriginal)
+    {
+        return allocate(pUserData, size, alignment, scope);
+    }
+    if (!size)
+    {
+        free_memory(pUserData, pOriginal);
+        return nullptr;
+    }
+
+    // On failure the original must be left untouched
+    const auto pMemory = allocate(pUserData, size, alignment, scope);
+    if (pMemory)
+    {
+        memcpy(pMemory, pOriginal, std::min(size, header_of(pOriginal)->size));
+        free_memory(pUserData, pOriginal);
+    }
+    return pMemory;
+}
+
+static void VKAPI_PTR internal_allocation(void *, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    record(scope, static_cast<int64_t>(size));
+}
+
+static void VKAPI_PTR internal_free(void *, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    record(scope, -static_cast<int64_t>(size));
+}
+
+const vk::AllocationCallbacks *HostAllocator::Callbacks(Mode mode)
+{
+    // The mode can't change once the driver holds allocations made under it
+    if (!s_installed)
+    {
+        s_mode = mode;
+        s_callbacks = vk::AllocationCallbacks()
+            .setPfnAllocation(allocate)
+            .setPfnReallocation(reallocate)
+            .setPfnFree(free_memory)
+            .setPfnInternalAllocation(internal_allocation)
+            .setPfnInternalFree(internal_free);
+        s_installed = true;
+    }
+    return &s_callbacks;
+}
+
+bool HostAllocator::IsInstalled()
+{
+    return s_installed;
+}
+
+void HostAllocator::FrameEnded()
+{
+    if (!s_installed)
+    {
+        return;
+    }
+
+    for (auto& counters : s_counters)
+    {
+        counters.lastFrameCalls.store(counters.frameCalls.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        counters.lastFrameBytes.store(counters.frameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+HostAllocator::Statistics HostAllocator::Collect()
+{
+    Statistics statistics;
+    for (size_t i = 0; i < SCOPE_COUNT; ++i)
+    {
+        const auto& counters = s_counters[i];
+        statistics[i].calls = counters.calls.load(std::memory_order_relaxed);
+        statistics[i].liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+        statistics[i].lastFrameCalls = counters.lastFrameCalls.load(std::memory_order_relaxed);
+        statistics[i].lastFrameBytes = counters.lastFrameBytes.load(std::memory_order_relaxed);
+    }
+    return statistics;
+}
+
+uint64_t HostAllocator::ArenaOverflows()
+{
+    return s_arenaOverflows.load(std::memory_order_relaxed);
+}
+
+const char *HostAllocator::ScopeName(vk::SystemAllocationScope scope)
+{
+    switch (scope)
+    {
+    case vk::SystemAllocationScope::eCommand:
+        return "Command";
+    case vk::SystemAllocationScope::eObject:
+        return "Object";
+    case vk::SystemAllocationScope::eCache:
+        return "Cache";
+    case vk::SystemAllocationScope::eDevice:
+        return "Device";
+    case vk::SystemAllocationScope::eInstance:
+        return "Instance";
+    default:
+        return "Unknown";
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+
+// VkAllocationCallbacks that count the driver's host allocations by
+// VkSystemAllocationScope, in total and per frame. In arena mode allocations
+// with command scope, which never outlive the Vulkan command that made them,
+// are bump-allocated from a per-thread block instead of the heap.
+class HostAllocator
+{
+public:
+    enum class Mode
+    {
+        Counting,
+        Arena,
+    };
+
+    struct ScopeStatistics
+    {
+        // Allocations, reallocations and frees, including internal ones the driver reported
+        uint64_t calls;
+        uint64_t liveBytes;
+        uint64_t lastFrameCalls;
+        uint64_t lastFrameBytes;
+    };
+
+    static constexpr size_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+    using Statistics = std::array<ScopeStatistics, SCOPE_COUNT>;
+
+    // The callbacks live as long as the process, pass them to every Vulkan call
+    // that takes them, e.g. through RendererOptions::pAllocationCallbacks
+    static const vk::AllocationCallbacks *Callbacks(Mode mode);
+    static bool IsInstalled();
+
+    // Called once per presented frame
+    static void FrameEnded();
+    static Statistics Collect();
+    // Command-scope allocations that did not fit the arena and went to the heap
+    static uint64_t ArenaOverflows();
+    static const char *ScopeName(vk::SystemAllocationScope scope);
+};
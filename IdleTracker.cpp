@@ -0,0 +1,85 @@
+#include "IdleTracker.hpp"
+
+#include "DrawDataHash.hpp"
+
+#include "imgui.h"
+#include "imgui_internal.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Upper bound on blocking, so content driven by wall-clock time still updates
+constexpr double MAX_IDLE_TIMEOUT = 1.0;
+// ImGui hides the text cursor at 0.8s and shows it again at 1.2s of every 1.2s cycle
+constexpr double CURSOR_BLINK_PERIOD = 1.2;
+constexpr double CURSOR_VISIBLE_TIME = 0.8;
+// Wakes just past the toggle, so the next frame's time is sure to cross it
+constexpr double CURSOR_BLINK_MARGIN = 0.001;
+
+// Time until the active text field's cursor toggles, or MAX_IDLE_TIMEOUT if none blinks
+static double cursor_blink_timeout()
+{
+    const auto& g = *ImGui::GetCurrentContext();
+    if (!g.IO.ConfigInputTextCursorBlink || !g.ActiveId || g.InputTextState.ID != g.ActiveId)
+    {
+        return MAX_IDLE_TIMEOUT;
+    }
+
+    // CursorAnim advances by DeltaTime each frame and restarts below zero on edits,
+    // the cursor stays visible until it passes CURSOR_VISIBLE_TIME
+    const double anim = g.InputTextState.CursorAnim;
+    if (anim < 0.0)
+    {
+        return CURSOR_VISIBLE_TIME - anim + CURSOR_BLINK_MARGIN;
+    }
+    const auto phase = std::fmod(anim, CURSOR_BLINK_PERIOD);
+    const auto next = phase < CURSOR_VISIBLE_TIME ? CURSOR_VISIBLE_TIME : CURSOR_BLINK_PERIOD;
+    return next - phase + CURSOR_BLINK_MARGIN;
+}
+
+IdleTracker::IdleTracker()
+    :lastHash(0), lastEventCount(0), unchangedFrames(0), wakeups(0), renderedFrames(0)
+{
+
+}
+
+bool IdleTracker::frameChanged(const ImDrawData *pDD, uint64_t eventCount)
+{
+    const auto hash = hash_draw_data(pDD);
+    const auto changed = hash != lastHash || !renderedFrames;
+    const auto eventsArrived = eventCount != lastEventCount;
+
+    unchangedFrames = (changed || eventsArrived) ? 0 : unchangedFrames + 1;
+    lastHash = hash;
+    lastEventCount = eventCount;
+
+    renderedFrames += changed;
+    return changed;
+}
+
+bool IdleTracker::isSettled() const
+{
+    return unchangedFrames >= SETTLE_FRAMES;
+}
+
+double IdleTracker::timeout() const
+{
+    // The caret is the only deadline ImGui schedules by itself, anything else
+    // animating keeps the UI from settling and never reaches an idle wait
+    return std::min(cursor_blink_timeout(), MAX_IDLE_TIMEOUT);
+}
+
+void IdleTracker::countWakeup()
+{
+    ++wakeups;
+}
+
+uint64_t IdleTracker::wakeupCount() const
+{
+    return wakeups;
+}
+
+uint64_t IdleTracker::renderedFrameCount() const
+{
+    return renderedFrames;
+}
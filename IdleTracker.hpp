@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+struct ImDrawData;
+
+// Decides when the frame loop may block for input instead of polling. The UI
+// counts as settled once a few consecutive frames produced identical draw
+// data without any events in between, which also covers ImGui animations and
+// hover states that need extra frames to converge.
+class IdleTracker
+{
+public:
+    IdleTracker();
+
+    // Call after ImGui::Render, returns whether the frame needs to be rendered
+    bool frameChanged(const ImDrawData *pDD, uint64_t eventCount);
+    bool isSettled() const;
+    // Seconds until the UI changes on its own, e.g. the next caret blink
+    double timeout() const;
+
+    void countWakeup();
+    uint64_t wakeupCount() const;
+    uint64_t renderedFrameCount() const;
+
+private:
+    static constexpr uint32_t SETTLE_FRAMES = 3;
+
+    uint64_t lastHash;
+    uint64_t lastEventCount;
+    uint32_t unchangedFrames;
+
+    uint64_t wakeups;
+    uint64_t renderedFrames;
+};
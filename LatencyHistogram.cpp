@@ -0,0 +1,49 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram()
+    :buckets{}, total(0)
+{
+
+}
+
+void LatencyHistogram::add(std::chrono::nanoseconds latency)
+{
+    const auto bucket = std::clamp<int64_t>(latency / BUCKET_WIDTH, 0, BUCKET_COUNT - 1);
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(uint32_t percent) const
+{
+    const auto target = (count() * percent + 99) / 100;
+    if (!target)
+    {
+        return {};
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            return BUCKET_WIDTH * (i + 1);
+        }
+    }
+    return BUCKET_WIDTH * BUCKET_COUNT;
+}
+
+void LatencyHistogram::copyBuckets(std::array<float, BUCKET_COUNT>& copy) const
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        copy[i] = static_cast<float>(buckets[i].load(std::memory_order_relaxed));
+    }
+}
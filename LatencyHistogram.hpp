@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+// Fixed-bucket histogram of latencies, written by one thread and readable
+// from any other without locking.
+class LatencyHistogram
+{
+public:
+    static constexpr size_t BUCKET_COUNT = 100;
+    // The last bucket also counts everything longer
+    static constexpr auto BUCKET_WIDTH = std::chrono::milliseconds(1);
+
+    LatencyHistogram();
+
+    void add(std::chrono::nanoseconds latency);
+    uint64_t count() const;
+    // Upper edge of the bucket holding the percentile, zero if empty
+    std::chrono::nanoseconds percentile(uint32_t percent) const;
+    // For plotting
+    void copyBuckets(std::array<float, BUCKET_COUNT>& buckets) const;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets;
+    std::atomic<uint64_t> total;
+};
@@ -0,0 +1,216 @@
+// vkwars-monitor: reads the telemetry segments of every running vkwars
+// process on this host and prints them with an aggregate across processes.
+
+#include "TelemetryLayout.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Where Linux exposes POSIX shared memory objects
+constexpr auto SHM_DIRECTORY = "/dev/shm";
+constexpr int SEQLOCK_RETRIES = 100;
+
+struct Snapshot
+{
+    int32_t pid;
+    uint32_t phaseCount;
+    char phaseNames[TELEMETRY_MAX_PHASES][TELEMETRY_NAME_SIZE];
+    TelemetrySample sample;
+};
+
+static bool read_segment(const std::string& name, Snapshot *pSnapshot)
+{
+    const auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    const auto pMemory = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const auto pSegment = static_cast<const TelemetrySegment *>(pMemory);
+    auto success = false;
+    // A process that died without unlinking its segment leaves it behind
+    if (pSegment->magic == TELEMETRY_MAGIC && pSegment->version == TELEMETRY_VERSION && !kill(pSegment->pid, 0))
+    {
+        // Everything before the sequence never changes after the segment was published
+        std::atomic_thread_fence(std::memory_order_acquire);
+        pSnapshot->pid = pSegment->pid;
+        pSnapshot->phaseCount = std::min(pSegment->phaseCount, TELEMETRY_MAX_PHASES);
+        memcpy(pSnapshot->phaseNames, pSegment->phaseNames, sizeof(pSnapshot->phaseNames));
+        for (int i = 0; i < SEQLOCK_RETRIES && !success; ++i)
+        {
+            const auto before = pSegment->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            memcpy(&pSnapshot->sample, &pSegment->sample, sizeof(TelemetrySample));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            success = pSegment->sequence.load(std::memory_order_relaxed) == before;
+        }
+    }
+
+    munmap(pMemory, sizeof(TelemetrySegment));
+    return success;
+}
+
+static std::vector<std::string> find_segments()
+{
+    std::vector<std::string> names;
+    const auto pDirectory = opendir(SHM_DIRECTORY);
+    if (!pDirectory)
+    {
+        return names;
+    }
+
+    const auto prefixLength = strlen(TELEMETRY_SEGMENT_PREFIX);
+    while (const auto pEntry = readdir(pDirectory))
+    {
+        if (!strncmp(pEntry->d_name, TELEMETRY_SEGMENT_PREFIX, prefixLength))
+        {
+            names.emplace_back("/" + std::string(pEntry->d_name));
+        }
+    }
+    closedir(pDirectory);
+    return names;
+}
+
+static double ms(int64_t nanoseconds)
+{
+    return nanoseconds / 1e6;
+}
+
+static double mb(uint64_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+static void print_snapshots(const std::vector<Snapshot>& snapshots)
+{
+    printf("%8s %10s %10s %9s %11s %11s %9s\n", "pid", "frames", "skipped", "frame ms", "GPU MB", "budget MB", "host MB");
+
+    uint64_t frames = 0, skipped = 0, gpuMemory = 0, hostMemory = 0;
+    int64_t frameTimeSum = 0, frameTimeMax = 0;
+    for (const auto& snapshot : snapshots)
+    {
+        const auto& sample = snapshot.sample;
+        printf("%8d %10llu %10llu %9.3f %11.1f %11.1f %9.2f\n", snapshot.pid,
+            static_cast<unsigned long long>(sample.frameCount), static_cast<unsigned long long>(sample.skippedFrames),
+            ms(sample.frameTime), mb(sample.gpuMemoryUsage), mb(sample.gpuMemoryBudget), mb(sample.hostMemoryBytes));
+
+        frames += sample.frameCount;
+        skipped += sample.skippedFrames;
+        gpuMemory += sample.gpuMemoryUsage;
+        hostMemory += sample.hostMemoryBytes;
+        frameTimeSum += sample.frameTime;
+        frameTimeMax = std::max(frameTimeMax, sample.frameTime);
+    }
+
+    if (!snapshots.empty())
+    {
+        printf("%zu processes: %llu frames, %llu skipped, frame time mean %.3fms max %.3fms, GPU %.1fMB, host %.2fMB\n",
+            snapshots.size(), static_cast<unsigned long long>(frames), static_cast<unsigned long long>(skipped),
+            ms(frameTimeSum / static_cast<int64_t>(snapshots.size())), ms(frameTimeMax), mb(gpuMemory), mb(hostMemory));
+    }
+    else
+    {
+        printf("No running vkwars processes publish telemetry\n");
+    }
+}
+
+static void print_phases(const Snapshot& snapshot)
+{
+    printf("pid %d:", snapshot.pid);
+    for (uint32_t i = 0; i < snapshot.phaseCount; ++i)
+    {
+        printf(" %.*s %.3f", static_cast<int>(TELEMETRY_NAME_SIZE), snapshot.phaseNames[i], ms(snapshot.sample.phaseTimes[i]));
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    auto interval = std::chrono::milliseconds(1000);
+    auto once = false;
+    auto phases = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--once"))
+        {
+            once = true;
+        }
+        else if (!strcmp(argv[i], "--phases"))
+        {
+            phases = true;
+        }
+        else if (!strcmp(argv[i], "--interval") && i + 1 < argc)
+        {
+            const auto pText = argv[++i];
+            char *pEnd;
+            errno = 0;
+            const auto ms = isdigit(static_cast<unsigned char>(*pText)) ? strtoul(pText, &pEnd, 10) : 0;
+            if (!ms || *pEnd || errno)
+            {
+                fprintf(stderr, "Invalid value '%s' for --interval, expected milliseconds of at least 1\n", pText);
+                fprintf(stderr, "Usage: %s [--once] [--phases] [--interval MS]\n", argv[0]);
+                return 1;
+            }
+            interval = std::chrono::milliseconds(ms);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--once] [--phases] [--interval MS]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (;;)
+    {
+        std::vector<Snapshot> snapshots;
+        for (const auto& name : find_segments())
+        {
+            Snapshot snapshot;
+            if (read_segment(name, &snapshot))
+            {
+                snapshots.emplace_back(snapshot);
+            }
+        }
+
+        print_snapshots(snapshots);
+        if (phases)
+        {
+            for (const auto& snapshot : snapshots)
+            {
+                print_phases(snapshot);
+            }
+        }
+
+        if (once)
+        {
+            return 0;
+        }
+        printf("\n");
+        std::this_thread::sleep_for(interval);
+    }
+}
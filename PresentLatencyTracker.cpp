@@ -0,0 +1,130 @@
+#include "PresentLatencyTracker.hpp"
+
+// How stale a present-wait sample may get, about the histogram's resolution
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(1);
+// Timeline waits return on completion, the timeout only bounds shutdown
+constexpr auto TIMELINE_WAIT_TIMEOUT = std::chrono::milliseconds(100);
+
+PresentLatencyTracker::PresentLatencyTracker()
+    :pTimeline(nullptr), pWaitForPresent(nullptr), stopping(false), firstPending(0), nextPending(0)
+{
+
+}
+
+PresentLatencyTracker::~PresentLatencyTracker()
+{
+    if (!thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+}
+
+void PresentLatencyTracker::init(vk::Device device, const Timeline& timeline, PFN_vkVoidFunction pWaitForPresent)
+{
+    this->device = device;
+    pTimeline = &timeline;
+    this->pWaitForPresent = pWaitForPresent;
+
+    thread = std::thread(&PresentLatencyTracker::run, this);
+}
+
+bool PresentLatencyTracker::presentWaitEnabled() const
+{
+    return pWaitForPresent != nullptr;
+}
+
+std::unique_lock<std::mutex> PresentLatencyTracker::lockSwapchain()
+{
+    return std::unique_lock(mutex);
+}
+
+void PresentLatencyTracker::add(uint64_t serial, vk::SwapchainKHR swapchain, uint64_t presentId, std::chrono::steady_clock::time_point inputTime)
+{
+    {
+        std::lock_guard lock(mutex);
+        // Drops the oldest when the display stopped completing presents
+        if (nextPending - firstPending == pendingFrames.size())
+        {
+            ++firstPending;
+        }
+        pendingFrames[nextPending++ % pendingFrames.size()] = { serial, swapchain, presentId, inputTime };
+    }
+    condition.notify_all();
+}
+
+void PresentLatencyTracker::dropPresents()
+{
+    // Timeline serials stay valid across swapchains, present ids don't
+    if (pWaitForPresent)
+    {
+        firstPending = nextPending;
+    }
+}
+
+const LatencyHistogram& PresentLatencyTracker::histogram() const
+{
+    return latencies;
+}
+
+void PresentLatencyTracker::run()
+{
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [this]{ return firstPending != nextPending || stopping; });
+        if (stopping)
+        {
+            return;
+        }
+
+        const auto index = firstPending;
+        const auto pending = pendingFrames[index % pendingFrames.size()];
+
+        vk::Result result;
+        std::chrono::steady_clock::time_point completed;
+#ifdef VK_KHR_present_wait
+        if (pWaitForPresent)
+        {
+            // Only polls, since the lock keeps acquires and presents out meanwhile
+            const auto waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(pWaitForPresent);
+            result = vk::Result(waitForPresent(device, pending.swapchain, pending.presentId, 0));
+            completed = std::chrono::steady_clock::now();
+            if (result == vk::Result::eTimeout)
+            {
+                condition.wait_for(lock, POLL_INTERVAL, [this]{ return stopping; });
+                continue;
+            }
+        }
+        else
+#endif
+        {
+            // Presents may go ahead, only add touches the ring meanwhile
+            lock.unlock();
+            result = pTimeline->wait(pending.serial, std::chrono::nanoseconds(TIMELINE_WAIT_TIMEOUT).count());
+            completed = std::chrono::steady_clock::now();
+            lock.lock();
+            if (result == vk::Result::eTimeout)
+            {
+                continue;
+            }
+        }
+
+        // Anything else means the frame never reached the display, e.g. an out of date swapchain
+        if (result == vk::Result::eSuccess)
+        {
+            latencies.add(completed - pending.inputTime);
+        }
+        // Unless add dropped it as the oldest in the meantime
+        if (firstPending == index)
+        {
+            ++firstPending;
+        }
+    }
+}
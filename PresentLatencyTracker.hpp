@@ -0,0 +1,64 @@
+#pragma once
+
+#include "LatencyHistogram.hpp"
+#include "Timeline.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Measures the time from input to the frame it drove reaching the display. A
+// thread of its own watches each frame, so samples are stamped when the
+// present completes instead of whenever the frame loop next looks, which may
+// be much later while it waits for events. Without VK_KHR_present_wait the
+// end of rendering on the GPU stands in for the present.
+class PresentLatencyTracker
+{
+public:
+    PresentLatencyTracker();
+    PresentLatencyTracker(const PresentLatencyTracker&) = delete;
+    ~PresentLatencyTracker();
+
+    PresentLatencyTracker& operator=(const PresentLatencyTracker&) = delete;
+
+    // pWaitForPresent is vkWaitForPresentKHR, or null to watch the timeline instead
+    void init(vk::Device device, const Timeline& timeline, PFN_vkVoidFunction pWaitForPresent);
+    bool presentWaitEnabled() const;
+
+    // Waiting for a present needs the swapchain externally synchronized, hold
+    // this around acquires, presents and replacing the swapchain
+    std::unique_lock<std::mutex> lockSwapchain();
+    // Call after the frame was presented with presentId, serial is its timeline serial
+    void add(uint64_t serial, vk::SwapchainKHR swapchain, uint64_t presentId, std::chrono::steady_clock::time_point inputTime);
+    // Forgets presents to the current swapchain, call with the lock held before it is retired
+    void dropPresents();
+
+    const LatencyHistogram& histogram() const;
+
+private:
+    struct PendingFrame
+    {
+        uint64_t serial;
+        vk::SwapchainKHR swapchain;
+        uint64_t presentId;
+        std::chrono::steady_clock::time_point inputTime;
+    };
+
+    void run();
+
+private:
+    vk::Device device;
+    const Timeline *pTimeline;
+    PFN_vkVoidFunction pWaitForPresent;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    // Ring indexed by the absolute frame index modulo its size
+    std::array<PendingFrame, 16> pendingFrames;
+    uint64_t firstPending, nextPending;
+
+    LatencyHistogram latencies;
+};
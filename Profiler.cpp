@@ -0,0 +1,146 @@
+#include "Profiler.hpp"
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+struct PhaseHistory
+{
+    std::atomic<uint64_t> count;
+    // Nanoseconds, saturated at ~4s
+    std::array<std::atomic<uint32_t>, Profiler::HISTORY_SIZE> samples;
+};
+
+static std::array<PhaseHistory, static_cast<size_t>(Profiler::Phase::Count)> s_histories;
+
+static size_t copy_samples(Profiler::Phase phase, std::array<uint32_t, Profiler::HISTORY_SIZE>& samples)
+{
+    const auto& history = s_histories[static_cast<size_t>(phase)];
+    const auto count = history.count.load(std::memory_order_relaxed);
+    const auto retained = static_cast<size_t>(std::min<uint64_t>(count, Profiler::HISTORY_SIZE));
+    const auto first = count - retained;
+    for (size_t i = 0; i < retained; ++i)
+    {
+        samples[i] = history.samples[(first + i) % Profiler::HISTORY_SIZE].load(std::memory_order_relaxed);
+    }
+    return retained;
+}
+
+void Profiler::Record(Phase phase, std::chrono::steady_clock::time_point start, std::chrono::nanoseconds duration)
+{
+    if (Trace::IsRecording())
+    {
+        const auto gpu = phase == Phase::GpuSubpass0 || phase == Phase::GpuSubpass1 || phase == Phase::GpuDrawList;
+        Trace::AddSpan(Name(phase), start, duration, gpu);
+    }
+
+    auto& history = s_histories[static_cast<size_t>(phase)];
+    const auto sample = static_cast<uint32_t>(std::clamp<std::chrono::nanoseconds::rep>(duration.count(), 0, std::numeric_limits<uint32_t>::max()));
+    const auto index = history.count.fetch_add(1, std::memory_order_relaxed);
+    history.samples[index % HISTORY_SIZE].store(sample, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds Profiler::Last(Phase phase)
+{
+    const auto& history = s_histories[static_cast<size_t>(phase)];
+    const auto count = history.count.load(std::memory_order_relaxed);
+    return std::chrono::nanoseconds(count ? history.samples[(count - 1) % HISTORY_SIZE].load(std::memory_order_relaxed) : 0);
+}
+
+Profiler::Summary Profiler::Summarize(Phase phase)
+{
+    std::array<uint32_t, HISTORY_SIZE> samples;
+    const auto count = copy_samples(phase, samples);
+    if (!count)
+    {
+        return {};
+    }
+
+    std::sort(samples.begin(), samples.begin() + count);
+    const auto percentile = [&](size_t percent) {
+        return std::chrono::nanoseconds(samples[(count - 1) * percent / 100]);
+    };
+
+    Summary summary;
+    summary.median = percentile(50);
+    summary.p90 = percentile(90);
+    summary.p99 = percentile(99);
+    summary.max = percentile(100);
+    return summary;
+}
+
+size_t Profiler::History(Phase phase, std::array<float, HISTORY_SIZE>& samples)
+{
+    std::array<uint32_t, HISTORY_SIZE> raw;
+    const auto count = copy_samples(phase, raw);
+    for (size_t i = 0; i < count; ++i)
+    {
+        samples[i] = raw[i] / 1e6f;
+    }
+    return count;
+}
+
+const char *Profiler::Name(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::PollEvents:
+        return "Poll events";
+    case Phase::BuildUI:
+        return "Build UI";
+    case Phase::WaitForFrame:
+        return "Wait for frame";
+    case Phase::Acquire:
+        return "Acquire";
+    case Phase::Record:
+        return "Record";
+    case Phase::CopyGeometry:
+        return "Copy geometry";
+    case Phase::Submit:
+        return "Submit";
+    case Phase::Present:
+        return "Present";
+    case Phase::Overlay:
+        return "Overlay";
+    case Phase::Render:
+        return "Render";
+    case Phase::UIRender:
+        return "UI render";
+    case Phase::UploadEnd:
+        return "Upload end";
+    case Phase::UploadFinish:
+        return "Upload finish";
+    case Phase::SwapchainRebuild:
+        return "Swapchain rebuild";
+    case Phase::GpuSubpass0:
+        return "GPU subpass 0";
+    case Phase::GpuSubpass1:
+        return "GPU subpass 1";
+    case Phase::GpuDrawList:
+        return "GPU draw list";
+    case Phase::Startup:
+        return "Startup";
+    case Phase::StartupInstance:
+        return "Startup: instance";
+    case Phase::StartupDevice:
+        return "Startup: device";
+    case Phase::StartupAllocator:
+        return "Startup: allocator";
+    case Phase::StartupRenderPass:
+        return "Startup: render pass";
+    case Phase::StartupFontAtlas:
+        return "Startup: font atlas";
+    case Phase::StartupShaders:
+        return "Startup: shaders";
+    case Phase::StartupFontUpload:
+        return "Startup: font upload";
+    case Phase::StartupPipeline:
+        return "Startup: pipeline";
+    case Phase::StartupSwapchain:
+        return "Startup: swapchain";
+    default:
+        return "Unknown";
+    }
+}
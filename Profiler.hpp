@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+// Process-wide CPU timers for the phases of the frame loop. Each phase keeps
+// its most recent samples in a fixed ring written with relaxed atomics, so
+// timing a scope costs two clock reads and never locks or allocates, from
+// any thread. Samples are forwarded to the Trace while one is recording.
+class Profiler
+{
+public:
+    enum class Phase
+    {
+        PollEvents,
+        BuildUI,
+        WaitForFrame,
+        Acquire,
+        Record,
+        CopyGeometry,
+        Submit,
+        Present,
+        Overlay,
+        Render,
+        UIRender,
+        UploadEnd,
+        UploadFinish,
+        SwapchainRebuild,
+        GpuSubpass0,
+        GpuSubpass1,
+        GpuDrawList,
+        // Renderer construction, steps on worker threads overlap the others
+        Startup,
+        StartupInstance,
+        StartupDevice,
+        StartupAllocator,
+        StartupRenderPass,
+        StartupFontAtlas,
+        StartupShaders,
+        StartupFontUpload,
+        StartupPipeline,
+        StartupSwapchain,
+        Count
+    };
+
+    struct Summary
+    {
+        std::chrono::nanoseconds median, p90, p99, max;
+    };
+
+    static constexpr size_t HISTORY_SIZE = 256;
+
+    // Times the enclosing scope
+    class Scope
+    {
+    public:
+        explicit Scope(Phase phase)
+            :phase(phase), start(std::chrono::steady_clock::now())
+        {
+
+        }
+        Scope(const Scope&) = delete;
+        ~Scope()
+        {
+            Profiler::Record(phase, start, std::chrono::steady_clock::now() - start);
+        }
+
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // GPU phases take start in host time
+    static void Record(Phase phase, std::chrono::steady_clock::time_point start, std::chrono::nanoseconds duration);
+    // Most recent sample, zero if there is none
+    static std::chrono::nanoseconds Last(Phase phase);
+    // Percentiles over the retained samples, zero if there are none
+    static Summary Summarize(Phase phase);
+    // Copies the retained samples in milliseconds, oldest first, and returns how many there were
+    static size_t History(Phase phase, std::array<float, HISTORY_SIZE>& samples);
+    static const char *Name(Phase phase);
+};
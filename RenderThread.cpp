@@ -0,0 +1,145 @@
+#include "RenderThread.hpp"
+
+template<typename T>
+static void copy_vector(ImVector<T>& dst, const ImVector<T>& src)
+{
+    // ImVector::operator= frees and reallocates, resize keeps the capacity
+    dst.resize(src.Size);
+    if (src.Size)
+    {
+        memcpy(dst.Data, src.Data, src.size_in_bytes());
+    }
+}
+
+DrawDataSnapshot::DrawDataSnapshot()
+{
+    drawData.Clear();
+}
+
+void DrawDataSnapshot::capture(const ImDrawData *pSource, std::chrono::steady_clock::time_point inputTime)
+{
+    sampledInputTime = inputTime;
+
+    while (cmdLists.size() < static_cast<size_t>(pSource->CmdListsCount))
+    {
+        cmdLists.emplace_back(std::make_unique<ImDrawList>(nullptr));
+    }
+    cmdListPointers.resize(pSource->CmdListsCount);
+
+    for (int i = 0; i < pSource->CmdListsCount; ++i)
+    {
+        const auto pSrc = pSource->CmdLists[i];
+        const auto pDst = cmdLists[i].get();
+
+        copy_vector(pDst->CmdBuffer, pSrc->CmdBuffer);
+        copy_vector(pDst->IdxBuffer, pSrc->IdxBuffer);
+        copy_vector(pDst->VtxBuffer, pSrc->VtxBuffer);
+        pDst->Flags = pSrc->Flags;
+        // Window names live as long as the context, debug labels use them
+        pDst->_OwnerName = pSrc->_OwnerName;
+
+        cmdListPointers[i] = pDst;
+    }
+
+    drawData.Valid = pSource->Valid;
+    drawData.CmdLists = cmdListPointers.data();
+    drawData.CmdListsCount = pSource->CmdListsCount;
+    drawData.TotalIdxCount = pSource->TotalIdxCount;
+    drawData.TotalVtxCount = pSource->TotalVtxCount;
+    drawData.DisplayPos = pSource->DisplayPos;
+    drawData.DisplaySize = pSource->DisplaySize;
+    drawData.FramebufferScale = pSource->FramebufferScale;
+}
+
+const ImDrawData *DrawDataSnapshot::get() const
+{
+    return &drawData;
+}
+
+std::chrono::steady_clock::time_point DrawDataSnapshot::inputTime() const
+{
+    return sampledInputTime;
+}
+
+RenderThread::RenderThread(Renderer& renderer)
+    :pRenderer(&renderer), submittedCount(0), renderedCount(0), stopping(false)
+{
+    thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+}
+
+void RenderThread::submit(const ImDrawData *pDrawData, std::chrono::steady_clock::time_point inputTime)
+{
+    std::unique_lock lock(mutex);
+    condition.wait(lock, [this]{ return submittedCount - renderedCount < SNAPSHOT_COUNT || failure; });
+    rethrow_if_failed();
+
+    // The render thread never touches slots between renderedCount and submittedCount
+    // other than the oldest one, so the free slot can be filled without the lock
+    const auto slot = submittedCount % SNAPSHOT_COUNT;
+    lock.unlock();
+
+    snapshots[slot].capture(pDrawData, inputTime);
+
+    lock.lock();
+    ++submittedCount;
+    lock.unlock();
+    condition.notify_all();
+}
+
+void RenderThread::flush()
+{
+    std::unique_lock lock(mutex);
+    condition.wait(lock, [this]{ return submittedCount == renderedCount || failure; });
+    rethrow_if_failed();
+}
+
+void RenderThread::run()
+{
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [this]{ return submittedCount != renderedCount || stopping; });
+        if (submittedCount == renderedCount)
+        {
+            return;
+        }
+
+        const auto slot = renderedCount % SNAPSHOT_COUNT;
+        lock.unlock();
+
+        try
+        {
+            pRenderer->render(snapshots[slot].get(), snapshots[slot].inputTime());
+        }
+        catch (...)
+        {
+            lock.lock();
+            failure = std::current_exception();
+            lock.unlock();
+            condition.notify_all();
+            return;
+        }
+
+        lock.lock();
+        ++renderedCount;
+        condition.notify_all();
+    }
+}
+
+void RenderThread::rethrow_if_failed()
+{
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+}
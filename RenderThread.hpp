@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Renderer.hpp"
+
+#include "imgui.h"
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// A deep copy of ImDrawData that stays valid after the next ImGui::NewFrame.
+// Draw lists and their buffers are reused between captures, so a steady UI
+// stops allocating once the arena has grown to fit it.
+class DrawDataSnapshot
+{
+public:
+    DrawDataSnapshot();
+
+    void capture(const ImDrawData *pSource, std::chrono::steady_clock::time_point inputTime);
+    const ImDrawData *get() const;
+    std::chrono::steady_clock::time_point inputTime() const;
+
+private:
+    ImDrawData drawData;
+    std::chrono::steady_clock::time_point sampledInputTime;
+    std::vector<std::unique_ptr<ImDrawList>> cmdLists;
+    std::vector<ImDrawList *> cmdListPointers;
+};
+
+// Records, submits and presents on a dedicated thread so the main thread can
+// start building the next ImGui frame as soon as the current one is captured.
+class RenderThread
+{
+public:
+    explicit RenderThread(Renderer& renderer);
+    RenderThread(const RenderThread&) = delete;
+    ~RenderThread();
+
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Blocks only while every snapshot slot is still queued or being rendered
+    void submit(const ImDrawData *pDrawData, std::chrono::steady_clock::time_point inputTime = {});
+    // Blocks until everything submitted was rendered. Required before touching
+    // the Renderer from another thread.
+    void flush();
+
+private:
+    static constexpr size_t SNAPSHOT_COUNT = 2;
+
+    void run();
+    void rethrow_if_failed();
+
+private:
+    Renderer *pRenderer;
+    std::array<DrawDataSnapshot, SNAPSHOT_COUNT> snapshots;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint64_t submittedCount, renderedCount;
+    bool stopping;
+    std::exception_ptr failure;
+
+    std::thread thread;
+};
@@ -1,20 +1,96 @@
 #include "Renderer.hpp"
 
+#include "CallCounter.hpp"
+#include "DrawDataHash.hpp"
+#include "HostAllocator.hpp"
+#include "Profiler.hpp"
 #include "RendererUtil.hpp"
+#include "Trace.hpp"
 #include "Uploader.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <thread>
+
 constexpr auto DEPTH_FORMAT = vk::Format::eD16Unorm;
+constexpr auto HEADLESS_SURFACE_FORMAT = vk::SurfaceFormatKHR{ vk::Format::eR8G8B8A8Srgb, vk::ColorSpaceKHR::eSrgbNonlinear };
+constexpr uint32_t HEADLESS_IMAGE_COUNT = 3;
+constexpr uint32_t TUNER_WINDOW = 120;
+constexpr uint32_t TUNER_STARVED_PERCENT = 5;
+constexpr int LATENCY_SMOOTHING = 16;
 constexpr uint32_t DESIRED_API_VERSION = VK_API_VERSION_1_2;
 constexpr auto DESIRED_COMPOSITE_ALPHA = std::array{ vk::CompositeAlphaFlagBitsKHR::eOpaque, vk::CompositeAlphaFlagBitsKHR::eInherit };
-constexpr auto DESIRED_PRESENT_MODES = std::array{ vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo };
+constexpr auto LATENCY_PRESENT_MODES = std::array{ vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo };
+constexpr auto THROUGHPUT_PRESENT_MODES = std::array{ vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo };
+constexpr auto POWER_PRESENT_MODES = std::array{ vk::PresentModeKHR::eFifo };
 constexpr uint32_t DEFAULT_IMAGE_COUNT = 3;
 
-static constexpr uint32_t compute_image_count(uint32_t min, uint32_t max)
+// Returns an empty vector if the file can't be read
+static std::vector<uint8_t> load_file(const std::string& path)
+{
+    std::vector<uint8_t> ret;
+    const auto pFile = fopen(path.c_str(), "rb");
+    if (!pFile)
+    {
+        return ret;
+    }
+
+    uint8_t buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), pFile)))
+    {
+        ret.insert(ret.end(), buffer, buffer + size);
+    }
+    fclose(pFile);
+    return ret;
+}
+
+// Drivers should reject foreign data themselves, but not all of them do
+static bool is_pipeline_cache_compatible(const std::vector<uint8_t>& data, const vk::PhysicalDeviceProperties& properties)
+{
+    struct Header
+    {
+        uint32_t size, version, vendorID, deviceID;
+        uint8_t uuid[VK_UUID_SIZE];
+    } header;
+    if (data.size() < sizeof(header))
+    {
+        return false;
+    }
+
+    memcpy(&header, data.data(), sizeof(header));
+    return header.version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && header.vendorID == properties.vendorID && header.deviceID == properties.deviceID
+        && !memcmp(header.uuid, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+}
+
+// A max of 0 means the surface has no upper limit
+static constexpr uint32_t compute_image_count(uint32_t requested, uint32_t min, uint32_t max)
 {
-    const auto ret = std::max(DEFAULT_IMAGE_COUNT, min);
+    const auto ret = std::max(requested ? requested : DEFAULT_IMAGE_COUNT, std::max(min, 1u));
     return max ? std::min(ret, max) : ret;
 }
 
+// Sets *pDebugUtilsEnabled to whether VK_EXT_debug_utils was added
+static std::vector<const char *> select_instance_extensions(std::vector<const char *> extensions, const RendererOptions& options, bool *pDebugUtilsEnabled)
+{
+    *pDebugUtilsEnabled = false;
+    if (options.debugUtils)
+    {
+        const auto availableExtensions = vk::enumerateInstanceExtensionProperties();
+        const auto debugUtilsSupported = std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const auto& extension) {
+            return !strcmp(extension.extensionName, DebugUtils::EXTENSION_NAME);
+        });
+        if (debugUtilsSupported)
+        {
+            extensions.emplace_back(DebugUtils::EXTENSION_NAME);
+            *pDebugUtilsEnabled = true;
+        }
+    }
+    return extensions;
+}
+
 static std::pair<vk::PhysicalDevice, uint32_t> select_device_and_queue(const std::vector<vk::PhysicalDevice>& physicalDevices, vk::SurfaceKHR surface)
 {
     for (const auto physicalDevice : physicalDevices)
@@ -22,7 +98,7 @@ static std::pair<vk::PhysicalDevice, uint32_t> select_device_and_queue(const std
         const auto queueFamilies = physicalDevice.getQueueFamilyProperties();
         for (uint32_t i = 0; i < queueFamilies.size(); ++i)
         {
-            if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics && physicalDevice.getSurfaceSupportKHR(i, surface))
+            if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics && (!surface || physicalDevice.getSurfaceSupportKHR(i, surface)))
             {
                 return {physicalDevice, i};
             }
@@ -32,8 +108,28 @@ static std::pair<vk::PhysicalDevice, uint32_t> select_device_and_queue(const std
     throw std::runtime_error("No supported vulkan device");
 }
 
-static vk::CompositeAlphaFlagBitsKHR select_composite_alpha(vk::CompositeAlphaFlagsKHR compositeAlpha)
+template<typename T>
+std::optional<T> select_first_supported(const std::vector<T>& desired, const std::vector<T>& supported)
+{
+    for (const auto& needle : desired)
+    {
+        if (std::find(supported.begin(), supported.end(), needle) != supported.end())
+        {
+            return needle;
+        }
+    }
+    return std::nullopt;
+}
+
+static vk::CompositeAlphaFlagBitsKHR select_composite_alpha(const std::vector<vk::CompositeAlphaFlagBitsKHR>& desired, vk::CompositeAlphaFlagsKHR compositeAlpha)
 {
+    for (const auto needle : desired)
+    {
+        if (compositeAlpha & needle)
+        {
+            return needle;
+        }
+    }
     for (const auto needle : DESIRED_COMPOSITE_ALPHA)
     {
         if (compositeAlpha & needle)
@@ -45,10 +141,24 @@ static vk::CompositeAlphaFlagBitsKHR select_composite_alpha(vk::CompositeAlphaFl
     throw std::runtime_error("No supported composite alpha");
 }
 
+static vk::ArrayProxy<const vk::PresentModeKHR> desired_present_modes(PresentPreference preference)
+{
+    switch (preference)
+    {
+    case PresentPreference::Throughput:
+        return THROUGHPUT_PRESENT_MODES;
+    case PresentPreference::Power:
+        return POWER_PRESENT_MODES;
+    case PresentPreference::Latency:
+    default:
+        return LATENCY_PRESENT_MODES;
+    }
+}
+
 template<typename T>
-vk::PresentModeKHR select_present_mode(const T begin, const T end)
+vk::PresentModeKHR select_present_mode(vk::ArrayProxy<const vk::PresentModeKHR> desired, const T begin, const T end)
 {
-    for (const auto needle : DESIRED_PRESENT_MODES)
+    for (const auto needle : desired)
     {
         if (std::find(begin, end, needle) != end)
         {
@@ -78,56 +188,265 @@ constexpr vk::SurfaceFormatKHR select_surface_format(const T begin, const T end)
     return *begin;
 }
 
-Renderer::Renderer(std::function<RequiredExtensionsCallback> requiredExtensionsCallback, std::function<SurfaceCreationCallback> surfaceCreationCallback)
-    :frameIndex(0)
+Renderer::Renderer(std::function<RequiredExtensionsCallback> requiredExtensionsCallback, std::function<SurfaceCreationCallback> surfaceCreationCallback, const RendererOptions& options)
+    :pAllocationCallbacks(options.pAllocationCallbacks), incrementalPresentSupported(false), debugUtilsEnabled(false), frameIndex(0), frameSerial(0), presentInterval(0), headlessImageIndex(0)
 {
+    Profiler::Scope profilerScope(Profiler::Phase::Startup);
+    // Needs no device, so it overlaps instance and device creation
+    uiRenderer.loadAssets();
+
     const auto applicationInfo = vk::ApplicationInfo()
         .setApiVersion(DESIRED_API_VERSION);
-    auto instanceCreateInfo = vk::InstanceCreateInfo()
-        .setPApplicationInfo(&applicationInfo);
-    instanceCreateInfo.setPpEnabledExtensionNames(requiredExtensionsCallback(&instanceCreateInfo.enabledExtensionCount));
+    uint32_t requiredExtensionCount;
+    const auto ppRequiredExtensions = requiredExtensionsCallback(&requiredExtensionCount);
+    const auto instanceExtensions = select_instance_extensions({ppRequiredExtensions, ppRequiredExtensions + requiredExtensionCount}, options, &debugUtilsEnabled);
+    const auto instanceCreateInfo = vk::InstanceCreateInfo()
+        .setPApplicationInfo(&applicationInfo)
+        .setPEnabledExtensionNames(instanceExtensions);
 
-    instance = vk::createInstanceUnique(instanceCreateInfo);
+    const auto instanceStart = std::chrono::steady_clock::now();
+    instance = vk::createInstanceUnique(instanceCreateInfo, pAllocationCallbacks);
+    Profiler::Record(Profiler::Phase::StartupInstance, instanceStart, std::chrono::steady_clock::now() - instanceStart);
 
     VkSurfaceKHR rawSurface;
-    check_success(surfaceCreationCallback(instance.get(), nullptr, &rawSurface));
-    surface = vk::UniqueSurfaceKHR(rawSurface, instance.get());
+    // The callback takes a non-const pointer, but only passes it on
+    const auto pRawCallbacks = const_cast<VkAllocationCallbacks *>(reinterpret_cast<const VkAllocationCallbacks *>(pAllocationCallbacks));
+    check_success(surfaceCreationCallback(instance.get(), pRawCallbacks, &rawSurface));
+    surface = vk::UniqueSurfaceKHR(rawSurface, {instance.get(), pAllocationCallbacks});
 
+    init(options);
+}
+
+Renderer::Renderer(vk::Extent2D headlessExtent, std::chrono::nanoseconds presentInterval, const RendererOptions& options)
+    :pAllocationCallbacks(options.pAllocationCallbacks), incrementalPresentSupported(false), debugUtilsEnabled(false), swapchainExtent(headlessExtent), frameIndex(0), frameSerial(0), presentInterval(presentInterval), nextPresentTime(std::chrono::steady_clock::now()), headlessImageIndex(0)
+{
+    Profiler::Scope profilerScope(Profiler::Phase::Startup);
+    // Needs no device, so it overlaps instance and device creation
+    uiRenderer.loadAssets();
+
+    const auto applicationInfo = vk::ApplicationInfo()
+        .setApiVersion(DESIRED_API_VERSION);
+    const auto instanceExtensions = select_instance_extensions({}, options, &debugUtilsEnabled);
+    const auto instanceCreateInfo = vk::InstanceCreateInfo()
+        .setPApplicationInfo(&applicationInfo)
+        .setPEnabledExtensionNames(instanceExtensions);
+
+    const auto instanceStart = std::chrono::steady_clock::now();
+    instance = vk::createInstanceUnique(instanceCreateInfo, pAllocationCallbacks);
+    Profiler::Record(Profiler::Phase::StartupInstance, instanceStart, std::chrono::steady_clock::now() - instanceStart);
+
+    init(options);
+}
+
+void Renderer::init(const RendererOptions& options)
+{
+    pipelineCachePath = options.pipelineCachePath;
+    std::future<std::vector<uint8_t>> pipelineCacheData;
+    if (!pipelineCachePath.empty())
+    {
+        pipelineCacheData = std::async(std::launch::async, load_file, pipelineCachePath);
+    }
+
+    const auto deviceStart = std::chrono::steady_clock::now();
     const auto physicalDevices = instance->enumeratePhysicalDevices();
     std::tie(physicalDevice, queueFamilyIndex) = select_device_and_queue(physicalDevices, surface.get());
 
     const auto queuePriorities = std::array{ 0.0f };
 
-    const auto deviceExtensions = std::array{
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    const auto availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+    const auto has_extension = [&availableExtensions](const char *pName) {
+        return std::any_of(availableExtensions.begin(), availableExtensions.end(), [pName](const auto& extension) {
+            return !strcmp(extension.extensionName, pName);
+        });
     };
 
+    auto vulkan12Features = vk::PhysicalDeviceVulkan12Features()
+        .setTimelineSemaphore(true);
+
+    std::vector<const char *> deviceExtensions;
+    auto presentWaitSupported = false;
+    if (!is_headless())
+    {
+        deviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+        incrementalPresentSupported = has_extension(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+        if (incrementalPresentSupported)
+        {
+            deviceExtensions.emplace_back(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+        }
+    }
+
+#ifdef VK_KHR_present_wait
+    // Tells when a frame actually reached the display, for input-to-present latency
+    auto presentIdFeatures = vk::PhysicalDevicePresentIdFeaturesKHR();
+    auto presentWaitFeatures = vk::PhysicalDevicePresentWaitFeaturesKHR();
+    if (!is_headless() && has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        const auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        presentWaitSupported = features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId && features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+    if (presentWaitSupported)
+    {
+        deviceExtensions.emplace_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.emplace_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        presentWaitFeatures.setPresentWait(true);
+        presentIdFeatures.setPresentId(true)
+            .setPNext(&presentWaitFeatures);
+        vulkan12Features.setPNext(&presentIdFeatures);
+    }
+#endif
+
+    // Lets GPU timestamps be placed on the host timeline of traces
+    const auto calibratedTimestampsSupported = options.gpuTimestamps && has_extension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    if (calibratedTimestampsSupported)
+    {
+        deviceExtensions.emplace_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
+
+    // Lets the allocator report the budget the driver grants instead of heap sizes
+    const auto memoryBudgetSupported = has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudgetSupported)
+    {
+        deviceExtensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
     const auto deviceQueueCreateInfos = std::array{
         vk::DeviceQueueCreateInfo()
             .setQueueFamilyIndex(queueFamilyIndex)
             .setQueuePriorities(queuePriorities)
     };
 
+    // Statistics are silently left off on devices that can't collect them
+    const auto pipelineStatisticsSupported = options.pipelineStatistics && physicalDevice.getFeatures().pipelineStatisticsQuery;
+    const auto enabledFeatures = vk::PhysicalDeviceFeatures()
+        .setPipelineStatisticsQuery(pipelineStatisticsSupported);
+
     const auto deviceCreateInfo = vk::DeviceCreateInfo()
+        .setPNext(&vulkan12Features)
+        .setPEnabledFeatures(&enabledFeatures)
         .setPEnabledExtensionNames(deviceExtensions)
         .setQueueCreateInfos(deviceQueueCreateInfos);
 
-    device = physicalDevice.createDeviceUnique(deviceCreateInfo);
-    queue = device->getQueue(queueFamilyIndex, 0);
+    device = physicalDevice.createDeviceUnique(deviceCreateInfo, pAllocationCallbacks);
+    Profiler::Record(Profiler::Phase::StartupDevice, deviceStart, std::chrono::steady_clock::now() - deviceStart);
+    if (debugUtilsEnabled)
+    {
+        debugUtils.init(instance.get(), device.get());
+    }
+    timeline.init(device.get(), pAllocationCallbacks);
+    debugUtils.setName(timeline.get(), "Timeline");
+    submissionQueue.init(device.get(), queueFamilyIndex, 0, timeline);
+    latencyTracker.init(device.get(), timeline, presentWaitSupported ? device->getProcAddr("vkWaitForPresentKHR") : nullptr);
+
+    const auto allocatorStart = std::chrono::steady_clock::now();
+    check_success(allocator.init(instance.get(), physicalDevice, device.get(), DESIRED_API_VERSION, pAllocationCallbacks, memoryBudgetSupported ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0));
+    Profiler::Record(Profiler::Phase::StartupAllocator, allocatorStart, std::chrono::steady_clock::now() - allocatorStart);
+
+    policy = options.swapchain;
+    policyChanged = false;
+    if (is_headless())
+    {
+        surfaceFormat = HEADLESS_SURFACE_FORMAT;
+        currentPresentMode = presentInterval.count() ? vk::PresentModeKHR::eFifo : vk::PresentModeKHR::eImmediate;
+    }
+    else
+    {
+        const auto surfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface.get());
+        const auto desiredFormat = select_first_supported(policy.surfaceFormats, surfaceFormats);
+        surfaceFormat = desiredFormat ? *desiredFormat : select_surface_format(surfaceFormats.begin(), surfaceFormats.end());
+    }
 
-    check_success(allocator.init(instance.get(), physicalDevice, device.get(), DESIRED_API_VERSION));
+    const auto renderPassStart = std::chrono::steady_clock::now();
+    renderPass = create_render_pass(vk::AttachmentLoadOp::eClear);
+    loadRenderPass = create_render_pass(vk::AttachmentLoadOp::eLoad);
+    debugUtils.setName(renderPass.get(), "Render pass (clear)");
+    debugUtils.setName(loadRenderPass.get(), "Render pass (load)");
+    Profiler::Record(Profiler::Phase::StartupRenderPass, renderPassStart, std::chrono::steady_clock::now() - renderPassStart);
+
+    // Only needs the device and the render pass, the allocator is thread-safe
+    auto swapchainBuilt = std::async(std::launch::async, [this]{
+        Profiler::Scope profilerScope(Profiler::Phase::StartupSwapchain);
+        if (is_headless())
+        {
+            build_offscreen_images();
+        }
+        else
+        {
+            build_swapchain();
+        }
+    });
 
-    const auto surfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface.get());
-    surfaceFormat = select_surface_format(surfaceFormats.begin(), surfaceFormats.end());
+    if (!pipelineCachePath.empty())
+    {
+        auto initialData = pipelineCacheData.get();
+        if (!is_pipeline_cache_compatible(initialData, physicalDevice.getProperties()))
+        {
+            initialData.clear();
+        }
+        const auto pipelineCacheCreateInfo = vk::PipelineCacheCreateInfo()
+            .setInitialDataSize(initialData.size())
+            .setPInitialData(initialData.data());
+        pipelineCache = device->createPipelineCacheUnique(pipelineCacheCreateInfo, pAllocationCallbacks);
+        debugUtils.setName(pipelineCache.get(), "Pipeline cache");
+    }
+
+    Uploader uploader(device.get(), pAllocationCallbacks, queueFamilyIndex, submissionQueue, allocator, debugUtils);
+
+    uploader.begin();
+
+    const auto frameCount = std::clamp(options.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+    gpuProfiler.init(instance.get(), physicalDevice, device.get(), pAllocationCallbacks, queueFamilyIndex, frameCount, options.gpuTimestamps, pipelineStatisticsSupported, calibratedTimestampsSupported);
+    uiRenderer.init(device.get(), pAllocationCallbacks, queueFamilyIndex, allocator, uploader, gpuProfiler, debugUtils, renderPass.get(), 1, pipelineCache.get(), frameCount);
+
+    uploader.end();
+
+    imageIndex = 0;
+    rebuildRequired = false;
+    frameSlotPending = imagePending = false;
+    frameWaitTime = gpuWait = swapchainWait = {};
+    inputLatency = {};
+    inputLatencySamples = 0;
+    presentId = 0;
+
+    skipRedundantFrames = options.skipRedundantFrames;
+    partialRedraw = options.partialRedraw;
+    skippedFrames = 0;
+
+    presentedFrames = 0;
+    if (options.telemetry)
+    {
+        telemetry.open(static_cast<uint32_t>(Profiler::Phase::Count), [](uint32_t phase) {
+            return Profiler::Name(static_cast<Profiler::Phase>(phase));
+        });
+    }
+
+    perFrameData.resize(frameCount);
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        init_frame(perFrameData[i], i);
+    }
+
+    tuner = {};
+    tuner.enabled = options.autoTuneFramesInFlight;
+    tuner.floor = 1;
+
+    swapchainBuilt.get();
+    check_success(uploader.finish());
+}
+
+// Both variants are compatible, so framebuffers and the pipeline work with either
+vk::UniqueRenderPass Renderer::create_render_pass(vk::AttachmentLoadOp colorLoadOp) const
+{
+    const auto colorFinalLayout = is_headless() ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
 
     const auto renderPassAttachments = std::array{
         vk::AttachmentDescription()
             .setFormat(surfaceFormat.format)
             .setSamples(vk::SampleCountFlagBits::e1)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setLoadOp(colorLoadOp)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
-            .setInitialLayout(vk::ImageLayout::eUndefined)
-            .setFinalLayout(vk::ImageLayout::ePresentSrcKHR),
+            .setInitialLayout(colorLoadOp == vk::AttachmentLoadOp::eLoad ? colorFinalLayout : vk::ImageLayout::eUndefined)
+            .setFinalLayout(colorFinalLayout),
         vk::AttachmentDescription()
             .setFormat(DEPTH_FORMAT)
             .setSamples(vk::SampleCountFlagBits::e1)
@@ -163,7 +482,9 @@ Renderer::Renderer(std::function<RequiredExtensionsCallback> requiredExtensionsC
             .setDstSubpass(0)
             .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
             .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+            // Headless images are reused without a semaphore, so the previous frame's writes must be made available to the load
+            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite)
             .setDependencyFlags(vk::DependencyFlagBits::eByRegion),
         vk::SubpassDependency()
             .setSrcSubpass(VK_SUBPASS_EXTERNAL)
@@ -186,134 +507,201 @@ Renderer::Renderer(std::function<RequiredExtensionsCallback> requiredExtensionsC
         .setAttachments(renderPassAttachments)
         .setSubpasses(renderPassSubpasses)
         .setDependencies(renderPassDependencies);
-    renderPass = device->createRenderPassUnique(renderPassCreateInfo);
-
-    Uploader uploader(device.get(), queueFamilyIndex, 0, allocator);
-
-    uploader.begin();
-
-    uiRenderer.init(device.get(), allocator, uploader, renderPass.get(), 1);
+    return device->createRenderPassUnique(renderPassCreateInfo, pAllocationCallbacks);
+}
 
-    uploader.end();
+void Renderer::init_frame(PerFrameData& perFrame, uint32_t index)
+{
+    const auto commandPoolCreateInfo = vk::CommandPoolCreateInfo()
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(queueFamilyIndex);
+    perFrame.commandPool = device->createCommandPoolUnique(commandPoolCreateInfo, pAllocationCallbacks);
+
+    const auto commandBufferAllocateInfo = vk::CommandBufferAllocateInfo()
+        .setCommandPool(perFrame.commandPool.get())
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(1);
+    const auto commandBuffers = device->allocateCommandBuffers(commandBufferAllocateInfo);
+    perFrame.commandBuffer = commandBuffers[0];
+    perFrame.serial = 0;
+
+    const auto semaphoreCreateInfo = vk::SemaphoreCreateInfo();
+    perFrame.semaphore = device->createSemaphoreUnique(semaphoreCreateInfo, pAllocationCallbacks);
+
+    debugUtils.setName(perFrame.commandBuffer, "Frame command buffer %u", index);
+    debugUtils.setName(perFrame.semaphore.get(), "Image acquired semaphore %u", index);
+}
 
-    for (auto& perFrame : perFrameData)
+Renderer::~Renderer()
+{
+    wait_all_frames();
+    if (pipelineCache)
     {
-        const auto commandPoolCreateInfo = vk::CommandPoolCreateInfo()
-            .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
-            .setQueueFamilyIndex(queueFamilyIndex);
-        perFrame.commandPool = device->createCommandPoolUnique(commandPoolCreateInfo);
-
-        const auto commandBufferAllocateInfo = vk::CommandBufferAllocateInfo()
-            .setCommandPool(perFrame.commandPool.get())
-            .setLevel(vk::CommandBufferLevel::ePrimary)
-            .setCommandBufferCount(1);
-        const auto commandBuffers = device->allocateCommandBuffers(commandBufferAllocateInfo);
-        perFrame.commandBuffer = commandBuffers[0];
+        save_pipeline_cache();
+    }
+}
 
-        const auto fenceCreateInfo = vk::FenceCreateInfo()
-            .setFlags(vk::FenceCreateFlagBits::eSignaled);
-        perFrame.fence = device->createFenceUnique(fenceCreateInfo);
+void Renderer::render(const ImDrawData *pDrawData, std::chrono::steady_clock::time_point inputTime)
+{
+    Profiler::Scope profilerScope(Profiler::Phase::Render);
 
-        const auto semaphoreCreateInfo = vk::SemaphoreCreateInfo();
-        perFrame.semaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
+    std::optional<uint64_t> drawDataHash;
+    if (skipRedundantFrames)
+    {
+        drawDataHash = hash_draw_data(pDrawData);
+        if (drawDataHash == lastPresentedHash)
+        {
+            ++skippedFrames;
+            return;
+        }
     }
 
-    build_swapchain();
+    if (beginFrame() && endFrame(pDrawData, inputTime))
+    {
+        lastPresentedHash = drawDataHash;
+    }
+}
 
-    check_success(uploader.finish());
+bool Renderer::beginFrame()
+{
+    return begin_frame(UINT64_MAX) == FrameStatus::Ready;
 }
 
-Renderer::~Renderer()
+Renderer::FrameStatus Renderer::tryBeginFrame(std::chrono::nanoseconds timeout)
 {
-    wait_all_fences();
+    return begin_frame(static_cast<uint64_t>(std::max<int64_t>(timeout.count(), 0)));
 }
 
-void Renderer::render()
+bool Renderer::endFrame(const ImDrawData *pDrawData, std::chrono::steady_clock::time_point inputTime)
 {
-    frameIndex = (frameIndex + 1) % perFrameData.size();
-    const auto& perFrame = perFrameData[frameIndex];
+    auto& perFrame = perFrameData[frameIndex];
+    auto& perImage = perImageData[imageIndex];
+
+    auto renderArea = vk::Rect2D({}, swapchainExtent);
+    if (partialRedraw)
+    {
+        const auto damageFrame = damageTracker.update(pDrawData, swapchainExtent);
+        if (perImage.renderedFrame)
+        {
+            renderArea = damageTracker.damageSince(perImage.renderedFrame);
+        }
+        perImage.renderedFrame = damageFrame;
+    }
+
+    device->resetCommandPool(perFrame.commandPool.get());
+    // Nothing changed since this image was last drawn: submit no work, but
+    // still chain the semaphores so the image can be presented as is
+    const auto commandBufferCount = is_empty_rect(renderArea) ? 0u : 1u;
+    if (commandBufferCount)
+    {
+        record_command_buffer(perImage, pDrawData, renderArea);
+    }
 
-    check_success(device->waitForFences(perFrame.fence.get(), true, UINT64_MAX));
+    // If everything submitted so far already retired, the GPU sat idle waiting for us
+    const auto starved = timeline.isComplete(frameSerial);
 
-    uint32_t imageIndex;
-    const auto imageIndexResult = device->acquireNextImageKHR(swapchain.get(), UINT64_MAX, perFrame.semaphore.get(), nullptr, &imageIndex);
+    const auto waitSemaphores = std::array{ perFrame.semaphore.get()};
+    const auto waitStages = std::array{ vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput) };
+    const auto commandBuffers = std::array{ perFrame.commandBuffer };
+    const auto renderCompleteSemaphores = std::array{ perImage.semaphore.get() };
 
-    bool swapchainUsable, rebuildRequired;
-    switch (imageIndexResult)
+    SubmitBatch batch;
+    batch.commandBuffers = vk::ArrayProxy<const vk::CommandBuffer>(commandBufferCount, commandBuffers.data());
+    if (!is_headless())
+    {
+        batch.waitSemaphores = waitSemaphores;
+        batch.waitStages = waitStages;
+        batch.signalSemaphores = renderCompleteSemaphores;
+    }
+
+    // Also submits any uploads queued since the last frame
+    const auto submitStart = std::chrono::steady_clock::now();
+    perFrame.serial = frameSerial = submissionQueue.enqueue(batch);
+    submissionQueue.flush();
+    const auto submitTime = std::chrono::steady_clock::now();
+    Profiler::Record(Profiler::Phase::Submit, submitStart, submitTime - submitStart);
+
+    if (inputTime.time_since_epoch().count())
+    {
+        const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(submitTime - inputTime);
+        inputLatency = inputLatencySamples ? inputLatency + (latency - inputLatency) / LATENCY_SMOOTHING : latency;
+        ++inputLatencySamples;
+    }
+
+    const auto presentResult = present_image(perImage, imageIndex, renderArea);
+    if (inputTime.time_since_epoch().count())
+    {
+        latencyTracker.add(frameSerial, swapchain.get(), presentId, inputTime);
+    }
+    CallCounter::FrameEnded();
+    HostAllocator::FrameEnded();
+    Trace::FrameEnded();
+    if (telemetry.isOpen())
+    {
+        publish_telemetry(std::chrono::steady_clock::now());
+    }
+
+    switch (presentResult)
     {
     case vk::Result::eSuccess:
-        swapchainUsable = true;
-        rebuildRequired = false;
         break;
     case vk::Result::eSuboptimalKHR:
-        swapchainUsable = true;
-        rebuildRequired = true;
-        break;
     case vk::Result::eErrorOutOfDateKHR:
-        swapchainUsable = false;
         rebuildRequired = true;
         break;
     default:
-        vk::throwResultException(imageIndexResult, "render");
+        vk::throwResultException(presentResult, "endFrame");
     }
-    if (swapchainUsable)
-    {
-        const auto& perImage = perImageData[imageIndex];
 
-        device->resetCommandPool(perFrame.commandPool.get());
-        record_command_buffer(perImage);
-
-        const auto waitSemaphores = std::array{ perFrame.semaphore.get()};
-        const auto waitStages = std::array{ vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput) };
-        const auto commandBuffers = std::array{ perFrame.commandBuffer };
-        const auto renderCompleteSemaphores = std::array{ perImage.semaphore.get()};
-
-        const auto submitInfo = vk::SubmitInfo()
-            .setWaitSemaphores(waitSemaphores)
-            .setWaitDstStageMask(waitStages)
-            .setCommandBuffers(commandBuffers)
-            .setSignalSemaphores(renderCompleteSemaphores);
-
-        device->resetFences(perFrame.fence.get());
-        queue.submit(submitInfo, perFrame.fence.get());
-
-        const auto imageIndices = std::array{ imageIndex };
-        const auto presentInfo = vk::PresentInfoKHR()
-            .setWaitSemaphores(renderCompleteSemaphores)
-            .setSwapchains(swapchain.get())
-            .setImageIndices(imageIndices);
-        // Passing a pointer (not a reference) here disables the
-        // enhanced version of this method which throws on OutOfDate
-        const auto presentResult = queue.presentKHR(&presentInfo);
-
-        switch (presentResult)
-        {
-        case vk::Result::eSuccess:
-            break;
-        case vk::Result::eSuboptimalKHR:
-        case vk::Result::eErrorOutOfDateKHR:
-            rebuildRequired = true;
-            break;
-        default:
-            vk::throwResultException(presentResult, "render");
-        }
+    // May resize perFrameData, so perFrame must not be used past this point
+    if (tuner.enabled)
+    {
+        tune_frames_in_flight(submitTime - waitEnd, frameWaitTime, starved);
     }
 
     if (rebuildRequired)
     {
         rebuild_swapchain();
+        return false;
     }
+    return true;
+}
+
+std::chrono::nanoseconds Renderer::inputToSubmitLatency() const
+{
+    return inputLatency;
+}
+
+const LatencyHistogram& Renderer::inputToPresentLatency() const
+{
+    return latencyTracker.histogram();
+}
+
+bool Renderer::presentWaitEnabled() const
+{
+    return latencyTracker.presentWaitEnabled();
+}
+
+std::chrono::nanoseconds Renderer::gpuWaitTime() const
+{
+    return gpuWait;
 }
 
-void Renderer::build_swapchain()
+std::chrono::nanoseconds Renderer::swapchainWaitTime() const
+{
+    return swapchainWait;
+}
+
+void Renderer::build_swapchain(vk::SwapchainKHR oldSwapchain)
 {
     const auto surfaceCaps = physicalDevice.getSurfaceCapabilitiesKHR(surface.get());
-    const auto compositeAlpha = select_composite_alpha(surfaceCaps.supportedCompositeAlpha);
-    const auto minImageCount = compute_image_count(surfaceCaps.minImageCount, surfaceCaps.minImageCount);
+    const auto compositeAlpha = select_composite_alpha(policy.compositeAlpha, surfaceCaps.supportedCompositeAlpha);
+    const auto minImageCount = compute_image_count(policy.imageCount, surfaceCaps.minImageCount, surfaceCaps.maxImageCount);
     swapchainExtent = surfaceCaps.currentExtent;
 
     const auto presentModes = physicalDevice.getSurfacePresentModesKHR(surface.get());
-    const auto presentMode = select_present_mode(presentModes.begin(), presentModes.end());
+    const auto presentMode = select_present_mode(desired_present_modes(policy.presentPreference), presentModes.begin(), presentModes.end());
+    currentPresentMode = presentMode;
 
     const auto swapchainCreateInfo = vk::SwapchainCreateInfoKHR()
         .setSurface(surface.get())
@@ -327,11 +715,49 @@ void Renderer::build_swapchain()
         .setCompositeAlpha(compositeAlpha)
         .setPresentMode(presentMode)
         .setClipped(true)
-        .setOldSwapchain(oldSwapchain.get());
+        .setOldSwapchain(oldSwapchain);
 
-    swapchain = device->createSwapchainKHRUnique(swapchainCreateInfo);
+    swapchain = device->createSwapchainKHRUnique(swapchainCreateInfo, pAllocationCallbacks);
+    debugUtils.setName(swapchain.get(), "Swapchain");
     const auto swapchainImages = device->getSwapchainImagesKHR(swapchain.get());
 
+    build_depth_image();
+
+    perImageData.resize(swapchainImages.size());
+    for (uint32_t i = 0; i < swapchainImages.size(); ++i)
+    {
+        auto& perImage = perImageData[i];
+
+        const auto imageViewCreateInfo = vk::ImageViewCreateInfo()
+            .setImage(swapchainImages[i])
+            .setViewType(vk::ImageViewType::e2D)
+            .setFormat(surfaceFormat.format)
+            .setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
+        perImage.imageView = device->createImageViewUnique(imageViewCreateInfo, pAllocationCallbacks);
+        perImage.renderedFrame = 0;
+
+        const auto framebufferAttachments = std::array{ perImage.imageView.get(), depthImageView.get() };
+
+        const auto framebufferCreateInfo = vk::FramebufferCreateInfo()
+            .setRenderPass(renderPass.get())
+            .setAttachments(framebufferAttachments)
+            .setWidth(swapchainExtent.width)
+            .setHeight(swapchainExtent.height)
+            .setLayers(1);
+        perImage.framebuffer = device->createFramebufferUnique(framebufferCreateInfo, pAllocationCallbacks);
+
+        const auto semaphoreCreateInfo = vk::SemaphoreCreateInfo();
+        perImage.semaphore = device->createSemaphoreUnique(semaphoreCreateInfo, pAllocationCallbacks);
+
+        debugUtils.setName(swapchainImages[i], "Swapchain image %u", i);
+        debugUtils.setName(perImage.imageView.get(), "Swapchain image view %u", i);
+        debugUtils.setName(perImage.framebuffer.get(), "Framebuffer %u", i);
+        debugUtils.setName(perImage.semaphore.get(), "Render complete semaphore %u", i);
+    }
+}
+
+void Renderer::build_depth_image()
+{
     const auto depthImageCreateInfo = vk::ImageCreateInfo()
         .setImageType(vk::ImageType::e2D)
         .setFormat(DEPTH_FORMAT)
@@ -342,26 +768,46 @@ void Renderer::build_swapchain()
         .setTiling(vk::ImageTiling::eOptimal)
         .setUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment);
 
-    std::tie(depthImage, depthMemory) = allocator.createImage(depthImageCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY);
+    std::tie(depthImage, depthMemory) = allocator.createImage(depthImageCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, 0, "Depth image");
 
     const auto depthImageViewCreateInfo = vk::ImageViewCreateInfo()
         .setImage(depthImage.get())
         .setViewType(vk::ImageViewType::e2D)
         .setFormat(DEPTH_FORMAT)
         .setSubresourceRange({ vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 });
-    depthImageView = device->createImageViewUnique(depthImageViewCreateInfo);
+    depthImageView = device->createImageViewUnique(depthImageViewCreateInfo, pAllocationCallbacks);
 
-    perImageData.resize(swapchainImages.size());
-    for (uint32_t i = 0; i < swapchainImages.size(); ++i)
+    debugUtils.setName(depthImage.get(), "Depth image");
+    debugUtils.setName(depthImageView.get(), "Depth image view");
+}
+
+void Renderer::build_offscreen_images()
+{
+    build_depth_image();
+
+    perImageData.resize(policy.imageCount ? policy.imageCount : HEADLESS_IMAGE_COUNT);
+    for (uint32_t i = 0; i < perImageData.size(); ++i)
     {
         auto& perImage = perImageData[i];
 
+        const auto imageCreateInfo = vk::ImageCreateInfo()
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(surfaceFormat.format)
+            .setExtent({swapchainExtent.width, swapchainExtent.height, 1})
+            .setMipLevels(1)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc);
+        std::tie(perImage.image, perImage.imageMemory) = allocator.createImage(imageCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, 0, "Offscreen images");
+
         const auto imageViewCreateInfo = vk::ImageViewCreateInfo()
-            .setImage(swapchainImages[i])
+            .setImage(perImage.image.get())
             .setViewType(vk::ImageViewType::e2D)
             .setFormat(surfaceFormat.format)
             .setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
-        perImage.imageView = device->createImageViewUnique(imageViewCreateInfo);
+        perImage.imageView = device->createImageViewUnique(imageViewCreateInfo, pAllocationCallbacks);
+        perImage.renderedFrame = 0;
 
         const auto framebufferAttachments = std::array{ perImage.imageView.get(), depthImageView.get() };
 
@@ -371,22 +817,339 @@ void Renderer::build_swapchain()
             .setWidth(swapchainExtent.width)
             .setHeight(swapchainExtent.height)
             .setLayers(1);
-        perImage.framebuffer = device->createFramebufferUnique(framebufferCreateInfo);
+        perImage.framebuffer = device->createFramebufferUnique(framebufferCreateInfo, pAllocationCallbacks);
 
-        const auto semaphoreCreateInfo = vk::SemaphoreCreateInfo();
-        perImage.semaphore = device->createSemaphoreUnique(semaphoreCreateInfo);
+        debugUtils.setName(perImage.image.get(), "Offscreen image %u", i);
+        debugUtils.setName(perImage.imageView.get(), "Offscreen image view %u", i);
+        debugUtils.setName(perImage.framebuffer.get(), "Framebuffer %u", i);
     }
 }
 
 void Renderer::rebuild_swapchain()
 {
-    wait_all_fences();
-    oldSwapchain = std::move(swapchain);
-    build_swapchain();
+    Profiler::Scope profilerScope(Profiler::Phase::SwapchainRebuild);
+
+    lastPresentedHash.reset();
+    damageTracker.reset();
+
+    // Frames already submitted keep using the old resources, so they retire
+    // with the last serial instead of stalling until the GPU drained
+    RetiredSwapchain retired;
+    retired.swapchain = std::move(swapchain);
+    retired.depthImage = std::move(depthImage);
+    retired.depthMemory = std::move(depthMemory);
+    retired.depthImageView = std::move(depthImageView);
+    retired.perImageData = std::move(perImageData);
+    perImageData.clear();
+
+    if (is_headless())
+    {
+        headlessImageIndex = 0;
+        build_offscreen_images();
+    }
+    else
+    {
+        // The old swapchain is passed on, and must not be waited on past this point
+        const auto swapchainLock = latencyTracker.lockSwapchain();
+        latencyTracker.dropPresents();
+        build_swapchain(retired.swapchain.get());
+    }
+
+    deletionQueue.retire(timeline.lastReserved(), std::move(retired));
+}
+
+uint64_t Renderer::lastFrameSerial() const
+{
+    return frameSerial;
+}
+
+bool Renderer::isFrameComplete(uint64_t serial) const
+{
+    return timeline.isComplete(serial);
+}
+
+const GpuProfiler::FrameStatistics& Renderer::pipelineStatistics() const
+{
+    return gpuProfiler.lastFrameStatistics();
+}
+
+bool Renderer::pipelineStatisticsEnabled() const
+{
+    return gpuProfiler.pipelineStatisticsEnabled();
+}
+
+uint32_t Renderer::memoryBudgets(std::array<VmaBudget, VK_MAX_MEMORY_HEAPS>& budgets) const
+{
+    return allocator.getBudgets(budgets);
+}
+
+vk::ArrayProxy<const vma::TagStatistics> Renderer::memoryTags() const
+{
+    return allocator.tagStatistics();
+}
+
+bool Renderer::dumpMemoryStatistics(const std::string& path) const
+{
+    const auto pFile = fopen(path.c_str(), "w");
+    if (!pFile)
+    {
+        fprintf(stderr, "Failed to open memory statistics file '%s'\n", path.c_str());
+        return false;
+    }
+
+    const auto statistics = allocator.buildStatsString(true);
+    fwrite(statistics.data(), 1, statistics.size(), pFile);
+    fclose(pFile);
+    return true;
+}
+
+uint64_t Renderer::skippedFrameCount() const
+{
+    return skippedFrames;
+}
+
+uint32_t Renderer::framesInFlight() const
+{
+    return static_cast<uint32_t>(perFrameData.size());
+}
+
+void Renderer::setFramesInFlight(uint32_t count)
+{
+    count = std::clamp(count, 1u, MAX_FRAMES_IN_FLIGHT);
+    if (count == perFrameData.size())
+    {
+        return;
+    }
+
+    wait_all_frames();
+
+    const auto oldCount = perFrameData.size();
+    perFrameData.resize(count);
+    for (size_t i = oldCount; i < perFrameData.size(); ++i)
+    {
+        init_frame(perFrameData[i], static_cast<uint32_t>(i));
+    }
+    uiRenderer.resize(count);
+    gpuProfiler.resize(count);
+
+    // Every slot is idle now, and no image is held while a beginFrame is pending
+    frameIndex = 0;
+    frameSlotPending = imagePending = false;
+}
+
+const SwapchainPolicy& Renderer::swapchainPolicy() const
+{
+    return policy;
+}
+
+void Renderer::setPresentPreference(PresentPreference preference)
+{
+    policyChanged |= policy.presentPreference != preference;
+    policy.presentPreference = preference;
+}
+
+void Renderer::setSwapchainImageCount(uint32_t count)
+{
+    policyChanged |= policy.imageCount != count;
+    policy.imageCount = count;
+}
+
+vk::PresentModeKHR Renderer::presentMode() const
+{
+    return currentPresentMode;
+}
+
+uint32_t Renderer::swapchainImageCount() const
+{
+    return static_cast<uint32_t>(perImageData.size());
+}
+
+bool Renderer::framesInFlightAutoTuned() const
+{
+    return tuner.enabled;
+}
+
+void Renderer::setFramesInFlightAutoTuned(bool enabled)
+{
+    tuner = {};
+    tuner.enabled = enabled;
+    tuner.floor = 1;
+}
+
+void Renderer::tune_frames_in_flight(std::chrono::nanoseconds cpuTime, std::chrono::nanoseconds waitTime, bool starved)
+{
+    tuner.sampleCount += 1;
+    tuner.starvedCount += starved;
+    tuner.cpuTime += cpuTime;
+    tuner.waitTime += waitTime;
+
+    if (tuner.sampleCount < TUNER_WINDOW)
+    {
+        return;
+    }
+
+    const auto depth = framesInFlight();
+    if (tuner.starvedCount * 100 > tuner.sampleCount * TUNER_STARVED_PERCENT)
+    {
+        // The GPU ran dry between submissions, queue more work ahead of it
+        if (depth < MAX_FRAMES_IN_FLIGHT)
+        {
+            tuner.floor = depth + 1;
+            setFramesInFlight(depth + 1);
+        }
+    }
+    else if (tuner.starvedCount == 0 && tuner.waitTime > tuner.cpuTime && depth > tuner.floor)
+    {
+        // GPU-bound: we spend longer blocked on it than recording, so the
+        // extra queued frame only adds latency
+        setFramesInFlight(depth - 1);
+    }
+
+    const auto enabled = tuner.enabled;
+    const auto floor = tuner.floor;
+    tuner = {};
+    tuner.enabled = enabled;
+    tuner.floor = floor;
+}
+
+bool Renderer::is_headless() const
+{
+    return !surface;
+}
+
+Renderer::FrameStatus Renderer::begin_frame(uint64_t timeout)
+{
+    if (!frameSlotPending && !imagePending)
+    {
+        if (policyChanged)
+        {
+            policyChanged = false;
+            rebuild_swapchain();
+        }
+        frameIndex = (frameIndex + 1) % perFrameData.size();
+        frameSlotPending = true;
+        frameWaitTime = {};
+    }
+    auto& perFrame = perFrameData[frameIndex];
+
+    if (frameSlotPending)
+    {
+        const auto waitStart = std::chrono::steady_clock::now();
+        const auto waitResult = timeline.wait(perFrame.serial, timeout);
+        waitEnd = std::chrono::steady_clock::now();
+        frameWaitTime += waitEnd - waitStart;
+        gpuWait += waitEnd - waitStart;
+        Profiler::Record(Profiler::Phase::WaitForFrame, waitStart, waitEnd - waitStart);
+        if (waitResult == vk::Result::eTimeout)
+        {
+            return FrameStatus::NotReady;
+        }
+        check_success(waitResult);
+        frameSlotPending = false;
+        imagePending = true;
+
+        if (!deletionQueue.empty())
+        {
+            deletionQueue.collect(timeline.completed());
+        }
+        gpuProfiler.collect(frameIndex);
+        allocator.setCurrentFrameIndex(static_cast<uint32_t>(frameSerial));
+    }
+
+    const auto acquireStart = std::chrono::steady_clock::now();
+    const auto imageIndexResult = acquire_image(perFrame, timeout, &imageIndex);
+    const auto acquireTime = std::chrono::steady_clock::now() - acquireStart;
+    swapchainWait += acquireTime;
+    Profiler::Record(Profiler::Phase::Acquire, acquireStart, acquireTime);
+    switch (imageIndexResult)
+    {
+    case vk::Result::eTimeout:
+    case vk::Result::eNotReady:
+        return FrameStatus::NotReady;
+    case vk::Result::eSuccess:
+        imagePending = false;
+        rebuildRequired = false;
+        return FrameStatus::Ready;
+    case vk::Result::eSuboptimalKHR:
+        imagePending = false;
+        rebuildRequired = true;
+        return FrameStatus::Ready;
+    case vk::Result::eErrorOutOfDateKHR:
+        imagePending = false;
+        rebuild_swapchain();
+        return FrameStatus::Rebuilt;
+    default:
+        vk::throwResultException(imageIndexResult, "beginFrame");
+    }
+}
+
+vk::Result Renderer::acquire_image(const PerFrameData& perFrame, uint64_t timeout, uint32_t *pImageIndex)
+{
+    if (is_headless())
+    {
+        headlessImageIndex = (headlessImageIndex + 1) % perImageData.size();
+        *pImageIndex = headlessImageIndex;
+        return vk::Result::eSuccess;
+    }
+
+    // Present waits are held off while this blocks, they resume as soon as it returns
+    const auto swapchainLock = latencyTracker.lockSwapchain();
+    return device->acquireNextImageKHR(swapchain.get(), timeout, perFrame.semaphore.get(), nullptr, pImageIndex);
 }
 
-void Renderer::record_command_buffer(const PerImageData& perImage)
+vk::Result Renderer::present_image(const PerImageData& perImage, uint32_t imageIndex, vk::Rect2D damage)
 {
+    Profiler::Scope profilerScope(Profiler::Phase::Present);
+
+    if (is_headless())
+    {
+        if (presentInterval.count())
+        {
+            // Simulated vsync: never present earlier than the next tick, but do not
+            // try to catch up on ticks that were missed.
+            std::this_thread::sleep_until(nextPresentTime);
+            nextPresentTime = std::max(nextPresentTime + presentInterval, std::chrono::steady_clock::now());
+        }
+        return vk::Result::eSuccess;
+    }
+
+    const auto renderCompleteSemaphores = std::array{ perImage.semaphore.get()};
+    const auto imageIndices = std::array{ imageIndex };
+    auto presentInfo = vk::PresentInfoKHR()
+        .setWaitSemaphores(renderCompleteSemaphores)
+        .setSwapchains(swapchain.get())
+        .setImageIndices(imageIndices);
+
+    // Zero rectangles would mean "everything changed", so an undamaged frame reports a single pixel
+    const auto damageRect = is_empty_rect(damage) ? vk::Rect2D({}, {1, 1}) : damage;
+    const auto presentRects = std::array{ vk::RectLayerKHR(damageRect.offset, damageRect.extent, 0) };
+    const auto presentRegions = std::array{ vk::PresentRegionKHR().setRectangles(presentRects) };
+    auto presentRegionsInfo = vk::PresentRegionsKHR()
+        .setRegions(presentRegions);
+    if (partialRedraw && incrementalPresentSupported)
+    {
+        presentInfo.setPNext(&presentRegionsInfo);
+    }
+
+#ifdef VK_KHR_present_wait
+    const auto presentIds = std::array{ ++presentId };
+    auto presentIdInfo = vk::PresentIdKHR()
+        .setPresentIds(presentIds);
+    if (latencyTracker.presentWaitEnabled())
+    {
+        presentIdInfo.setPNext(presentInfo.pNext);
+        presentInfo.setPNext(&presentIdInfo);
+    }
+#endif
+
+    const auto swapchainLock = latencyTracker.lockSwapchain();
+    return submissionQueue.present(presentInfo);
+}
+
+void Renderer::record_command_buffer(const PerImageData& perImage, const ImDrawData *pDrawData, vk::Rect2D renderArea)
+{
+    Profiler::Scope profilerScope(Profiler::Phase::Record);
+
     const auto& perFrame = perFrameData[frameIndex];
     const auto cb = perFrame.commandBuffer;
 
@@ -398,36 +1161,75 @@ void Renderer::record_command_buffer(const PerImageData& perImage)
         vk::ClearValue(vk::ClearDepthStencilValue(1.0f))
     };
 
+    // Partial redraws keep the previous contents and only clear the damaged area
+    const auto fullRedraw = renderArea == vk::Rect2D({}, swapchainExtent);
+
     const auto rpBeginInfo = vk::RenderPassBeginInfo()
-        .setRenderPass(renderPass.get())
+        .setRenderPass(fullRedraw ? renderPass.get() : loadRenderPass.get())
         .setFramebuffer(perImage.framebuffer.get())
-        .setRenderArea({{}, swapchainExtent})
+        .setRenderArea(renderArea)
         .setClearValues(clearValues);
 
-    const auto viewport = vk::Viewport{
-        0.0f, 0.0f,
-        static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height),
-        0.0f, 1.0
-    };
-
     cb.begin(cbBeginInfo);
+    debugUtils.beginLabel(cb, "Frame");
+    gpuProfiler.beginFrame(cb, frameIndex, pDrawData->CmdListsCount, swapchainExtent);
     cb.beginRenderPass(rpBeginInfo, vk::SubpassContents::eInline);
-    cb.setViewport(0, viewport);
+    debugUtils.beginLabel(cb, "Subpass 0");
 
-    cb.nextSubpass(vk::SubpassContents::eInline);
+    if (!fullRedraw)
+    {
+        const auto clearAttachment = vk::ClearAttachment()
+            .setAspectMask(vk::ImageAspectFlagBits::eColor)
+            .setColorAttachment(0)
+            .setClearValue(clearValues[0]);
+        const auto clearRect = vk::ClearRect(renderArea, 0, 1);
+        cb.clearAttachments(clearAttachment, clearRect);
+    }
 
-    uiRenderer.render(cb, swapchainExtent, frameIndex);
+    gpuProfiler.endSubpass0(cb, frameIndex);
+    debugUtils.endLabel(cb);
+    // Subpass 1 only executes secondaries, its label is recorded by the UIRenderer
+    cb.nextSubpass(vk::SubpassContents::eSecondaryCommandBuffers);
+
+    uiRenderer.render(cb, swapchainExtent, renderArea, frameIndex, pDrawData);
 
     cb.endRenderPass();
+    gpuProfiler.endFrame(cb, frameIndex);
+    debugUtils.endLabel(cb);
     cb.end();
 }
 
-void Renderer::wait_all_fences() const
+void Renderer::publish_telemetry(std::chrono::steady_clock::time_point frameEnd)
 {
-    std::vector<vk::Fence> allFences;
-    for (const auto& perFrame : perFrameData)
+    TelemetrySample sample = {};
+    sample.frameCount = ++presentedFrames;
+    sample.skippedFrames = skippedFrames;
+    sample.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(frameEnd.time_since_epoch()).count();
+    sample.frameTime = presentedFrames > 1 ? std::chrono::duration_cast<std::chrono::nanoseconds>(frameEnd - lastFrameEnd).count() : 0;
+    lastFrameEnd = frameEnd;
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(Profiler::Phase::Count) && i < TELEMETRY_MAX_PHASES; ++i)
+    {
+        sample.phaseTimes[i] = Profiler::Last(static_cast<Profiler::Phase>(i)).count();
+    }
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    const auto heapCount = allocator.getBudgets(budgets);
+    for (uint32_t i = 0; i < heapCount; ++i)
     {
-        allFences.emplace_back(perFrame.fence.get());
+        sample.gpuMemoryUsage += budgets[i].usage;
+        sample.gpuMemoryBudget += budgets[i].budget;
     }
-    check_success(device->waitForFences(allFences, true, UINT64_MAX));
+
+    for (const auto& scope : HostAllocator::Collect())
+    {
+        sample.hostMemoryBytes += scope.liveBytes;
+    }
+
+    telemetry.publish(sample);
+}
+
+void Renderer::wait_all_frames()
+{
+    check_success(submissionQueue.wait(timeline.lastReserved()));
 }
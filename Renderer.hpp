@@ -1,15 +1,84 @@
 #pragma once
 
+#include "DamageTracker.hpp"
+#include "DebugUtils.hpp"
+#include "DeletionQueue.hpp"
+#include "GpuProfiler.hpp"
+#include "PresentLatencyTracker.hpp"
+#include "SubmissionQueue.hpp"
+#include "Telemetry.hpp"
+#include "Timeline.hpp"
 #include "UIRenderer.hpp"
 
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+
+enum class PresentPreference
+{
+    // Newest frame on every vblank without tearing, mailbox where available
+    Latency,
+    // Never waits for vblank, may tear
+    Throughput,
+    // Strict vsync, the GPU idles whenever the queue of images is full
+    Power,
+};
+
+struct SwapchainPolicy
+{
+    // 0 picks the default, clamped to what the surface supports
+    uint32_t imageCount = 0;
+    PresentPreference presentPreference = PresentPreference::Latency;
+    // Tried in order, empty picks any 8-bit sRGB format. Fixed at creation.
+    std::vector<vk::SurfaceFormatKHR> surfaceFormats;
+    // Tried in order, empty prefers opaque. Fixed at creation.
+    std::vector<vk::CompositeAlphaFlagBitsKHR> compositeAlpha;
+};
+
+struct RendererOptions
+{
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    // Pick the smallest frames-in-flight depth that keeps the GPU busy
+    bool autoTuneFramesInFlight = false;
+    // Skip recording, submission and present when the draw data matches the last presented frame
+    bool skipRedundantFrames = false;
+    // Only redraw regions whose draw commands changed, using VK_KHR_incremental_present when available
+    bool partialRedraw = false;
+    // Time subpasses and draw lists on the GPU, reported through the Profiler
+    bool gpuTimestamps = false;
+    // Count vertices, primitives and fragment invocations of each UI draw list
+    bool pipelineStatistics = false;
+    // Name Vulkan objects and label command buffers for capture tools, when VK_EXT_debug_utils is available
+    bool debugUtils = false;
+    // Publish per-frame telemetry to shared memory for vkwars-monitor
+    bool telemetry = false;
+    // Pipeline cache loaded at startup and saved on destruction, empty disables it
+    std::string pipelineCachePath;
+    // Host allocations of the driver and the allocator, null uses the driver's own.
+    // Must outlive the renderer.
+    const vk::AllocationCallbacks *pAllocationCallbacks = nullptr;
+    SwapchainPolicy swapchain;
+};
+
 struct Renderer
 {
 public:
     using RequiredExtensionsCallback = const char **(uint32_t *pCount);
     using SurfaceCreationCallback = VkResult(VkInstance instance, VkAllocationCallbacks *allocator, VkSurfaceKHR *pSurface);
 
+    enum class FrameStatus
+    {
+        Ready,
+        NotReady,
+        Rebuilt,
+    };
+
 public:
-    Renderer(std::function<RequiredExtensionsCallback> requiredExtensionsCallback, std::function<SurfaceCreationCallback> surfaceCreationCallback);
+    Renderer(std::function<RequiredExtensionsCallback> requiredExtensionsCallback, std::function<SurfaceCreationCallback> surfaceCreationCallback, const RendererOptions& options = {});
+    // Renders into a ring of offscreen images instead of a swapchain. A non-zero
+    // presentInterval throttles "presentation" to a simulated vsync clock.
+    Renderer(vk::Extent2D headlessExtent, std::chrono::nanoseconds presentInterval, const RendererOptions& options = {});
     Renderer(const Renderer&) = delete;
     Renderer(Renderer&&) noexcept = default;
     ~Renderer();
@@ -17,7 +86,60 @@ public:
     Renderer& operator=(const Renderer&) = delete;
     Renderer& operator=(Renderer&&) noexcept = default;
 
-    void render();
+    // inputTime is when the input that drove this frame was sampled, if known
+    void render(const ImDrawData *pDrawData, std::chrono::steady_clock::time_point inputTime = {});
+
+    // render() split in two, so input can be sampled after the waits. beginFrame
+    // waits for a frame slot and acquires an image, it returns false when the
+    // swapchain had to be rebuilt instead. endFrame must follow a successful
+    // beginFrame and returns whether the frame was presented without needing a
+    // rebuild. Frames are never skipped on this path.
+    bool beginFrame();
+    // beginFrame that gives up after timeout, once on the frame slot and once on
+    // the image, and returns NotReady so the caller can do other work. The next
+    // call resumes where this one stopped. endFrame must follow Ready only.
+    FrameStatus tryBeginFrame(std::chrono::nanoseconds timeout);
+    bool endFrame(const ImDrawData *pDrawData, std::chrono::steady_clock::time_point inputTime = {});
+
+    // Smoothed time from input sampling to queue submission
+    std::chrono::nanoseconds inputToSubmitLatency() const;
+    // Time from input to the frame it drove reaching the display, stamped within
+    // a millisecond of the present. Without present wait the end of rendering
+    // stands in for the present.
+    const LatencyHistogram& inputToPresentLatency() const;
+    bool presentWaitEnabled() const;
+    // Total time beginFrame spent blocked on the GPU and on the presentation engine
+    std::chrono::nanoseconds gpuWaitTime() const;
+    std::chrono::nanoseconds swapchainWaitTime() const;
+
+    uint64_t lastFrameSerial() const;
+    bool isFrameComplete(uint64_t serial) const;
+
+    uint64_t skippedFrameCount() const;
+
+    // Statistics of the most recently completed frame, zero unless enabled and supported
+    const GpuProfiler::FrameStatistics& pipelineStatistics() const;
+    bool pipelineStatisticsEnabled() const;
+
+    // Per-heap usage and budget, returns the number of heaps
+    uint32_t memoryBudgets(std::array<VmaBudget, VK_MAX_MEMORY_HEAPS>& budgets) const;
+    // Live allocations by owner
+    vk::ArrayProxy<const vma::TagStatistics> memoryTags() const;
+    // Writes the allocator's detailed JSON statistics
+    bool dumpMemoryStatistics(const std::string& path) const;
+
+    uint32_t framesInFlight() const;
+    void setFramesInFlight(uint32_t count);
+    bool framesInFlightAutoTuned() const;
+    void setFramesInFlightAutoTuned(bool enabled);
+
+    // Changes take effect at the start of the next frame, by rebuilding the swapchain
+    const SwapchainPolicy& swapchainPolicy() const;
+    void setPresentPreference(PresentPreference preference);
+    void setSwapchainImageCount(uint32_t count);
+    // What the surface actually granted, which may differ from the policy
+    vk::PresentModeKHR presentMode() const;
+    uint32_t swapchainImageCount() const;
 
 private:
     struct PerFrameData
@@ -25,25 +147,64 @@ private:
         vk::UniqueCommandPool commandPool;
         vk::CommandBuffer commandBuffer;
 
-        vk::UniqueFence fence;
+        uint64_t serial;
         vk::UniqueSemaphore semaphore;
     };
 
+    struct FramesInFlightTuner
+    {
+        bool enabled;
+        // Depths below this starved the GPU before, don't oscillate back into them
+        uint32_t floor;
+        uint32_t sampleCount, starvedCount;
+        std::chrono::nanoseconds cpuTime, waitTime;
+    };
+
     struct PerImageData
     {
+        // Only owned in headless mode, swapchain images belong to the swapchain
+        vk::UniqueImage image;
+        vma::Allocation imageMemory;
+
         vk::UniqueImageView imageView;
         vk::UniqueFramebuffer framebuffer;
 
         vk::UniqueSemaphore semaphore;
+
+        // DamageTracker frame whose contents the image holds, 0 if undefined
+        uint64_t renderedFrame;
+    };
+
+    // Members in destruction-safe order, the swapchain goes last
+    struct RetiredSwapchain
+    {
+        vk::UniqueSwapchainKHR swapchain;
+        vk::UniqueImage depthImage;
+        vma::Allocation depthMemory;
+        vk::UniqueImageView depthImageView;
+        std::vector<PerImageData> perImageData;
     };
 
 private:
-    void build_swapchain();
+    void init(const RendererOptions& options);
+    vk::UniqueRenderPass create_render_pass(vk::AttachmentLoadOp colorLoadOp) const;
+    void init_frame(PerFrameData& perFrame, uint32_t index);
+    void tune_frames_in_flight(std::chrono::nanoseconds cpuTime, std::chrono::nanoseconds waitTime, bool starved);
+    void build_swapchain(vk::SwapchainKHR oldSwapchain = nullptr);
+    void build_depth_image();
+    void build_offscreen_images();
+    bool is_headless() const;
+    FrameStatus begin_frame(uint64_t timeout);
+    vk::Result acquire_image(const PerFrameData& perFrame, uint64_t timeout, uint32_t *pImageIndex);
+    vk::Result present_image(const PerImageData& perImage, uint32_t imageIndex, vk::Rect2D damage);
     void rebuild_swapchain();
-    void record_command_buffer(const PerImageData& perImage);
-    void wait_all_fences() const;
+    void record_command_buffer(const PerImageData& perImage, const ImDrawData *pDrawData, vk::Rect2D renderArea);
+    void wait_all_frames();
+    void publish_telemetry(std::chrono::steady_clock::time_point frameEnd);
+    void save_pipeline_cache() const;
 
 private:
+    const vk::AllocationCallbacks *pAllocationCallbacks;
     vk::UniqueInstance instance;
     vk::UniqueSurfaceKHR surface;
 
@@ -51,23 +212,67 @@ private:
     uint32_t queueFamilyIndex;
 
     vk::UniqueDevice device;
-    vk::Queue queue;
+    bool incrementalPresentSupported;
+    // Whether the instance was created with VK_EXT_debug_utils
+    bool debugUtilsEnabled;
+    DebugUtils debugUtils;
+    Timeline timeline;
+    SubmissionQueue submissionQueue;
 
     vma::Allocator allocator;
 
+    SwapchainPolicy policy;
+    bool policyChanged;
     vk::SurfaceFormatKHR surfaceFormat;
-    vk::UniqueRenderPass renderPass;
+    vk::PresentModeKHR currentPresentMode;
+    vk::UniqueRenderPass renderPass, loadRenderPass;
+
+    std::string pipelineCachePath;
+    vk::UniquePipelineCache pipelineCache;
 
+    GpuProfiler gpuProfiler;
     UIRenderer uiRenderer;
 
-    std::array<PerFrameData, MAX_FRAMES_IN_FLIGHT> perFrameData;
+    std::vector<PerFrameData> perFrameData;
+    FramesInFlightTuner tuner;
 
     vk::Extent2D swapchainExtent;
-    vk::UniqueSwapchainKHR swapchain, oldSwapchain;
+    vk::UniqueSwapchainKHR swapchain;
     vk::UniqueImage depthImage;
     vma::Allocation depthMemory;
     vk::UniqueImageView depthImageView;
     std::vector<PerImageData> perImageData;
+    DeletionQueue deletionQueue;
 
     uint32_t frameIndex;
+    uint64_t frameSerial;
+
+    uint32_t imageIndex;
+    bool rebuildRequired;
+    // Progress of a beginFrame interrupted by a timeout
+    bool frameSlotPending, imagePending;
+    std::chrono::steady_clock::time_point waitEnd;
+    std::chrono::nanoseconds frameWaitTime, gpuWait, swapchainWait;
+
+    std::chrono::nanoseconds inputLatency;
+    uint64_t inputLatencySamples;
+
+    uint64_t presentId;
+    // Destroyed before the swapchains its thread waits on
+    PresentLatencyTracker latencyTracker;
+
+    bool skipRedundantFrames;
+    std::optional<uint64_t> lastPresentedHash;
+    uint64_t skippedFrames;
+
+    bool partialRedraw;
+    DamageTracker damageTracker;
+
+    Telemetry telemetry;
+    uint64_t presentedFrames;
+    std::chrono::steady_clock::time_point lastFrameEnd;
+
+    std::chrono::nanoseconds presentInterval;
+    std::chrono::steady_clock::time_point nextPresentTime;
+    uint32_t headlessImageIndex;
 };
@@ -2,7 +2,8 @@
 
 #include <vulkan/vulkan.hpp>
 
-static constexpr size_t MAX_FRAMES_IN_FLIGHT = 2;
+static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
 
 inline constexpr void check_success(vk::Result result)
 {
@@ -22,4 +23,40 @@ constexpr T check_success(vk::ResultValue<T> result)
 inline constexpr void check_success(VkResult result)
 {
     check_success(vk::Result(result));
-}
\ No newline at end of file
+}
+
+inline constexpr bool is_empty_rect(const vk::Rect2D& rect)
+{
+    return !rect.extent.width || !rect.extent.height;
+}
+
+inline constexpr vk::Rect2D intersect_rects(const vk::Rect2D& a, const vk::Rect2D& b)
+{
+    const auto x0 = std::max(a.offset.x, b.offset.x);
+    const auto y0 = std::max(a.offset.y, b.offset.y);
+    const auto x1 = std::min(a.offset.x + static_cast<int32_t>(a.extent.width), b.offset.x + static_cast<int32_t>(b.extent.width));
+    const auto y1 = std::min(a.offset.y + static_cast<int32_t>(a.extent.height), b.offset.y + static_cast<int32_t>(b.extent.height));
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return {};
+    }
+    return {{x0, y0}, {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}};
+}
+
+inline constexpr vk::Rect2D union_rects(const vk::Rect2D& a, const vk::Rect2D& b)
+{
+    if (is_empty_rect(a))
+    {
+        return b;
+    }
+    if (is_empty_rect(b))
+    {
+        return a;
+    }
+
+    const auto x0 = std::min(a.offset.x, b.offset.x);
+    const auto y0 = std::min(a.offset.y, b.offset.y);
+    const auto x1 = std::max(a.offset.x + static_cast<int32_t>(a.extent.width), b.offset.x + static_cast<int32_t>(b.extent.width));
+    const auto y1 = std::max(a.offset.y + static_cast<int32_t>(a.extent.height), b.offset.y + static_cast<int32_t>(b.extent.height));
+    return {{x0, y0}, {static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0)}};
+}
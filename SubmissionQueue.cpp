@@ -0,0 +1,119 @@
+#include "SubmissionQueue.hpp"
+
+#include "CallCounter.hpp"
+
+SubmissionQueue::SubmissionQueue()
+    :pTimeline(nullptr), submittedSerial(0)
+{
+
+}
+
+void SubmissionQueue::init(vk::Device device, uint32_t queueFamilyIndex, uint32_t queueIndex, Timeline& timeline)
+{
+    queue = device.getQueue(queueFamilyIndex, queueIndex);
+    pTimeline = &timeline;
+}
+
+uint64_t SubmissionQueue::enqueue(const SubmitBatch& batch)
+{
+    std::lock_guard lock(mutex);
+
+    // Reserved under the lock, so serials are signalled in submission order
+    const auto serial = pTimeline->reserve();
+
+    PendingBatch pendingBatch;
+    pendingBatch.commandBufferOffset = static_cast<uint32_t>(commandBuffers.size());
+    pendingBatch.commandBufferCount = batch.commandBuffers.size();
+    commandBuffers.insert(commandBuffers.end(), batch.commandBuffers.begin(), batch.commandBuffers.end());
+
+    pendingBatch.waitOffset = static_cast<uint32_t>(waitSemaphores.size());
+    pendingBatch.waitCount = batch.waitSemaphores.size();
+    waitSemaphores.insert(waitSemaphores.end(), batch.waitSemaphores.begin(), batch.waitSemaphores.end());
+    waitStages.insert(waitStages.end(), batch.waitStages.begin(), batch.waitStages.end());
+
+    pendingBatch.signalOffset = static_cast<uint32_t>(signalSemaphores.size());
+    pendingBatch.signalCount = batch.signalSemaphores.size() + 1;
+    signalSemaphores.emplace_back(pTimeline->get());
+    signalValues.emplace_back(serial);
+    for (const auto semaphore : batch.signalSemaphores)
+    {
+        // Binary semaphores ignore their value, but the counts must match
+        signalSemaphores.emplace_back(semaphore);
+        signalValues.emplace_back(0);
+    }
+
+    pending.emplace_back(pendingBatch);
+    return serial;
+}
+
+void SubmissionQueue::flush()
+{
+    std::lock_guard lock(mutex);
+    flush_locked();
+}
+
+vk::Result SubmissionQueue::present(const vk::PresentInfoKHR& presentInfo)
+{
+    std::lock_guard lock(mutex);
+    flush_locked();
+    // Passing a pointer (not a reference) here disables the
+    // enhanced version of this method which throws on OutOfDate
+    return queue.presentKHR(&presentInfo, COUNTING_DISPATCH);
+}
+
+vk::Result SubmissionQueue::wait(uint64_t serial, uint64_t timeout)
+{
+    {
+        std::lock_guard lock(mutex);
+        if (serial > submittedSerial)
+        {
+            flush_locked();
+        }
+    }
+    return pTimeline->wait(serial, timeout);
+}
+
+const Timeline& SubmissionQueue::timeline() const
+{
+    return *pTimeline;
+}
+
+void SubmissionQueue::flush_locked()
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    // Sized up front, the submit infos point into these
+    timelineSubmitInfos.resize(pending.size());
+    submitInfos.resize(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        const auto& batch = pending[i];
+
+        timelineSubmitInfos[i] = vk::TimelineSemaphoreSubmitInfo()
+            .setSignalSemaphoreValueCount(batch.signalCount)
+            .setPSignalSemaphoreValues(signalValues.data() + batch.signalOffset);
+
+        submitInfos[i] = vk::SubmitInfo()
+            .setPNext(&timelineSubmitInfos[i])
+            .setWaitSemaphoreCount(batch.waitCount)
+            .setPWaitSemaphores(waitSemaphores.data() + batch.waitOffset)
+            .setPWaitDstStageMask(waitStages.data() + batch.waitOffset)
+            .setCommandBufferCount(batch.commandBufferCount)
+            .setPCommandBuffers(commandBuffers.data() + batch.commandBufferOffset)
+            .setSignalSemaphoreCount(batch.signalCount)
+            .setPSignalSemaphores(signalSemaphores.data() + batch.signalOffset);
+    }
+
+    queue.submit(submitInfos, nullptr, COUNTING_DISPATCH);
+    submittedSerial = pTimeline->lastReserved();
+
+    pending.clear();
+    commandBuffers.clear();
+    waitSemaphores.clear();
+    waitStages.clear();
+    signalSemaphores.clear();
+    signalValues.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Timeline.hpp"
+
+#include <mutex>
+
+struct SubmitBatch
+{
+    vk::ArrayProxy<const vk::CommandBuffer> commandBuffers = nullptr;
+    vk::ArrayProxy<const vk::Semaphore> waitSemaphores = nullptr;
+    vk::ArrayProxy<const vk::PipelineStageFlags> waitStages = nullptr;
+    // Binary semaphores, the timeline serial is signalled automatically
+    vk::ArrayProxy<const vk::Semaphore> signalSemaphores = nullptr;
+};
+
+// The only owner of the vk::Queue. Work may be enqueued from any thread and is
+// coalesced into a single vkQueueSubmit with one SubmitInfo per batch on the
+// next flush, typically once per frame.
+class SubmissionQueue
+{
+public:
+    SubmissionQueue();
+
+    void init(vk::Device device, uint32_t queueFamilyIndex, uint32_t queueIndex, Timeline& timeline);
+
+    // Returns the timeline serial the batch will signal
+    uint64_t enqueue(const SubmitBatch& batch);
+    void flush();
+    vk::Result present(const vk::PresentInfoKHR& presentInfo);
+
+    // Flushes first if the serial was only enqueued so far
+    vk::Result wait(uint64_t serial, uint64_t timeout = UINT64_MAX);
+    const Timeline& timeline() const;
+
+private:
+    struct PendingBatch
+    {
+        uint32_t commandBufferOffset, commandBufferCount;
+        uint32_t waitOffset, waitCount;
+        uint32_t signalOffset, signalCount;
+    };
+
+    void flush_locked();
+
+private:
+    vk::Queue queue;
+    Timeline *pTimeline;
+
+    std::mutex mutex;
+    uint64_t submittedSerial;
+
+    // Storage is kept across flushes, so steady-state submission does not allocate
+    std::vector<PendingBatch> pending;
+    std::vector<vk::CommandBuffer> commandBuffers;
+    std::vector<vk::Semaphore> waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    std::vector<vk::Semaphore> signalSemaphores;
+    std::vector<uint64_t> signalValues;
+    std::vector<vk::TimelineSemaphoreSubmitInfo> timelineSubmitInfos;
+    std::vector<vk::SubmitInfo> submitInfos;
+};
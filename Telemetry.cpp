@@ -0,0 +1,104 @@
+#include "Telemetry.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Telemetry::Telemetry()
+    :pSegment(nullptr)
+{
+
+}
+
+Telemetry::Telemetry(Telemetry&& other) noexcept
+    :pSegment(std::exchange(other.pSegment, nullptr)), name(std::move(other.name))
+{
+
+}
+
+Telemetry::~Telemetry()
+{
+    close();
+}
+
+Telemetry& Telemetry::operator=(Telemetry&& other) noexcept
+{
+    close();
+    pSegment = std::exchange(other.pSegment, nullptr);
+    name = std::move(other.name);
+    return *this;
+}
+
+bool Telemetry::open(uint32_t phaseCount, const char *(*pfnPhaseName)(uint32_t))
+{
+    close();
+
+    name = "/" + std::string(TELEMETRY_SEGMENT_PREFIX) + std::to_string(getpid());
+    const auto fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create telemetry segment '%s'\n", name.c_str());
+        return false;
+    }
+
+    void *pMemory = MAP_FAILED;
+    if (!ftruncate(fd, sizeof(TelemetrySegment)))
+    {
+        pMemory = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (pMemory == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map telemetry segment '%s'\n", name.c_str());
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // ftruncate zero-filled the segment, so the sequence starts at 0
+    pSegment = static_cast<TelemetrySegment *>(pMemory);
+    pSegment->version = TELEMETRY_VERSION;
+    pSegment->pid = getpid();
+    pSegment->phaseCount = std::min(phaseCount, TELEMETRY_MAX_PHASES);
+    for (uint32_t i = 0; i < pSegment->phaseCount; ++i)
+    {
+        strncpy(pSegment->phaseNames[i], pfnPhaseName(i), TELEMETRY_NAME_SIZE - 1);
+    }
+    // Readers ignore the segment until the magic shows up
+    std::atomic_thread_fence(std::memory_order_release);
+    pSegment->magic = TELEMETRY_MAGIC;
+    return true;
+}
+
+bool Telemetry::isOpen() const
+{
+    return pSegment;
+}
+
+void Telemetry::publish(const TelemetrySample& sample)
+{
+    if (!pSegment)
+    {
+        return;
+    }
+
+    const auto sequence = pSegment->sequence.load(std::memory_order_relaxed);
+    pSegment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&pSegment->sample, &sample, sizeof(sample));
+    pSegment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void Telemetry::close()
+{
+    if (pSegment)
+    {
+        munmap(pSegment, sizeof(TelemetrySegment));
+        shm_unlink(name.c_str());
+        pSegment = nullptr;
+    }
+}
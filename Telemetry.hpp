@@ -0,0 +1,33 @@
+#pragma once
+
+#include "TelemetryLayout.hpp"
+
+#include <string>
+
+// Publishes a TelemetrySample per frame into a POSIX shared-memory segment
+// named after the process, which vkwars-monitor reads. Publishing is a
+// seqlock-protected copy, with no locks, syscalls or allocations.
+class Telemetry
+{
+public:
+    Telemetry();
+    Telemetry(const Telemetry&) = delete;
+    Telemetry(Telemetry&& other) noexcept;
+    ~Telemetry();
+
+    Telemetry& operator=(const Telemetry&) = delete;
+    Telemetry& operator=(Telemetry&& other) noexcept;
+
+    // Creates the segment, returns false and leaves telemetry off on failure
+    bool open(uint32_t phaseCount, const char *(*pfnPhaseName)(uint32_t));
+    bool isOpen() const;
+
+    void publish(const TelemetrySample& sample);
+
+private:
+    void close();
+
+private:
+    TelemetrySegment *pSegment;
+    std::string name;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Layout of the shared-memory segment each vkwars process publishes its
+// telemetry in, read by vkwars-monitor. Bump TELEMETRY_VERSION on any change.
+constexpr uint32_t TELEMETRY_MAGIC = 0x54574b56; // "VKWT"
+constexpr uint32_t TELEMETRY_VERSION = 1;
+// Followed by the pid
+constexpr auto TELEMETRY_SEGMENT_PREFIX = "vkwars-telemetry.";
+constexpr uint32_t TELEMETRY_MAX_PHASES = 32;
+constexpr uint32_t TELEMETRY_NAME_SIZE = 32;
+
+struct TelemetrySample
+{
+    uint64_t frameCount;
+    uint64_t skippedFrames;
+    // steady_clock nanoseconds at publication, comparable between processes on one host
+    int64_t timestamp;
+    int64_t frameTime;
+    // Most recent sample of each phase, in nanoseconds
+    int64_t phaseTimes[TELEMETRY_MAX_PHASES];
+    uint64_t gpuMemoryUsage, gpuMemoryBudget;
+    uint64_t hostMemoryBytes;
+};
+
+struct TelemetrySegment
+{
+    // Written once before the segment is published
+    uint32_t magic, version;
+    int32_t pid;
+    uint32_t phaseCount;
+    char phaseNames[TELEMETRY_MAX_PHASES][TELEMETRY_NAME_SIZE];
+
+    // Seqlock: odd while the writer updates the sample, readers retry until
+    // they saw the same even value before and after copying it
+    std::atomic<uint32_t> sequence;
+    TelemetrySample sample;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "The seqlock must be address-free to work across processes");
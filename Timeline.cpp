@@ -0,0 +1,74 @@
+#include "Timeline.hpp"
+
+Timeline::Timeline()
+    :lastSerial(0), completedSerial(0)
+{
+
+}
+
+void Timeline::init(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks)
+{
+    this->device = device;
+
+    auto semaphoreTypeCreateInfo = vk::SemaphoreTypeCreateInfo()
+        .setSemaphoreType(vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+    const auto semaphoreCreateInfo = vk::SemaphoreCreateInfo()
+        .setPNext(&semaphoreTypeCreateInfo);
+    semaphore = device.createSemaphoreUnique(semaphoreCreateInfo, pAllocationCallbacks);
+}
+
+uint64_t Timeline::reserve()
+{
+    return ++lastSerial;
+}
+
+uint64_t Timeline::lastReserved() const
+{
+    return lastSerial;
+}
+
+uint64_t Timeline::completed() const
+{
+    const auto serial = device.getSemaphoreCounterValue(semaphore.get());
+    advance_completed(serial);
+    return serial;
+}
+
+bool Timeline::isComplete(uint64_t serial) const
+{
+    return serial <= completedSerial || serial <= completed();
+}
+
+vk::Result Timeline::wait(uint64_t serial, uint64_t timeout) const
+{
+    if (serial <= completedSerial)
+    {
+        return vk::Result::eSuccess;
+    }
+
+    const auto semaphores = std::array{ semaphore.get() };
+    const auto values = std::array{ serial };
+    const auto semaphoreWaitInfo = vk::SemaphoreWaitInfo()
+        .setSemaphores(semaphores)
+        .setValues(values);
+    const auto result = device.waitSemaphores(semaphoreWaitInfo, timeout);
+    if (result == vk::Result::eSuccess)
+    {
+        advance_completed(serial);
+    }
+    return result;
+}
+
+vk::Semaphore Timeline::get() const
+{
+    return semaphore.get();
+}
+
+void Timeline::advance_completed(uint64_t serial) const
+{
+    auto current = completedSerial.load();
+    while (current < serial && !completedSerial.compare_exchange_weak(current, serial))
+    {
+    }
+}
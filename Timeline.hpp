@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+
+// A timeline semaphore signalled with a monotonically increasing serial by
+// every queue submission. Any subsystem may ask whether a given serial has
+// finished on the GPU without blocking. Queries are thread-safe, reserve()
+// must be serialized with the submissions (see SubmissionQueue).
+class Timeline
+{
+public:
+    Timeline();
+
+    void init(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks);
+
+    uint64_t reserve();
+    uint64_t lastReserved() const;
+    uint64_t completed() const;
+    bool isComplete(uint64_t serial) const;
+    vk::Result wait(uint64_t serial, uint64_t timeout = UINT64_MAX) const;
+
+    vk::Semaphore get() const;
+
+private:
+    void advance_completed(uint64_t serial) const;
+
+private:
+    vk::Device device;
+    vk::UniqueSemaphore semaphore;
+
+    std::atomic<uint64_t> lastSerial;
+    mutable std::atomic<uint64_t> completedSerial;
+};
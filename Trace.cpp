@@ -0,0 +1,173 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Further spans of a capture are dropped
+constexpr size_t MAX_TRACE_EVENTS = 1 << 16;
+constexpr uint32_t GPU_TRACK = 0;
+
+struct TraceEvent
+{
+    // Written last, a null name marks a slot that is not complete yet
+    std::atomic<const char *> pName;
+    uint32_t track;
+    bool counter;
+    // Counters keep their value in duration
+    int64_t start, duration;
+};
+
+enum class TraceState
+{
+    Idle,
+    Recording,
+    Writing,
+};
+
+static std::atomic<TraceState> s_state{TraceState::Idle};
+static std::vector<TraceEvent> s_events;
+static std::atomic<size_t> s_eventCount;
+static uint32_t s_remainingFrames;
+static std::string s_path;
+static std::thread s_writer;
+
+static uint32_t current_track()
+{
+    static std::atomic<uint32_t> s_nextTrack{GPU_TRACK + 1};
+    thread_local const auto track = s_nextTrack.fetch_add(1, std::memory_order_relaxed);
+    return track;
+}
+
+static void write_trace()
+{
+    const auto pFile = fopen(s_path.c_str(), "w");
+    if (!pFile)
+    {
+        fprintf(stderr, "Failed to open trace file '%s'\n", s_path.c_str());
+        return;
+    }
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(pFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU_TRACK);
+
+    const auto recordedCount = s_eventCount.load();
+    const auto count = std::min(recordedCount, MAX_TRACE_EVENTS);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto& event = s_events[i];
+        const auto pName = event.pName.load(std::memory_order_acquire);
+        if (!pName)
+        {
+            continue;
+        }
+        // Microseconds, the unit the format expects
+        if (event.counter)
+        {
+            fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"counter\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"count\":%lld}}",
+                pName, event.start / 1000.0, static_cast<long long>(event.duration));
+            continue;
+        }
+        fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            pName, event.track == GPU_TRACK ? "gpu" : "cpu", event.track, event.start / 1000.0, event.duration / 1000.0);
+    }
+
+    fprintf(pFile, "\n]}\n");
+    fclose(pFile);
+
+    printf("Wrote %zu trace events to %s\n", count, s_path.c_str());
+    if (recordedCount > count)
+    {
+        fprintf(stderr, "Trace buffer full, dropped %zu events, capture fewer frames\n", recordedCount - count);
+    }
+}
+
+void Trace::Start(uint32_t frameCount, const std::string& path)
+{
+    auto expected = TraceState::Idle;
+    if (!frameCount || s_state.load() != expected)
+    {
+        return;
+    }
+
+    if (s_events.empty())
+    {
+        s_events = std::vector<TraceEvent>(MAX_TRACE_EVENTS);
+    }
+    for (auto& event : s_events)
+    {
+        event.pName.store(nullptr, std::memory_order_relaxed);
+    }
+    s_eventCount.store(0, std::memory_order_relaxed);
+    s_remainingFrames = frameCount;
+    s_path = path;
+
+    s_state.compare_exchange_strong(expected, TraceState::Recording);
+}
+
+bool Trace::IsRecording()
+{
+    return s_state.load(std::memory_order_acquire) == TraceState::Recording;
+}
+
+static void add_event(const char *pName, uint32_t track, bool counter, std::chrono::steady_clock::time_point start, int64_t duration)
+{
+    const auto index = s_eventCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= MAX_TRACE_EVENTS)
+    {
+        return;
+    }
+
+    auto& event = s_events[index];
+    event.track = track;
+    event.counter = counter;
+    event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+    event.duration = duration;
+    event.pName.store(pName, std::memory_order_release);
+}
+
+void Trace::AddSpan(const char *pName, std::chrono::steady_clock::time_point start, std::chrono::nanoseconds duration, bool gpu)
+{
+    if (IsRecording())
+    {
+        add_event(pName, gpu ? GPU_TRACK : current_track(), false, start, duration.count());
+    }
+}
+
+void Trace::AddCounter(const char *pName, std::chrono::steady_clock::time_point time, int64_t value)
+{
+    if (IsRecording())
+    {
+        add_event(pName, 0, true, time, value);
+    }
+}
+
+void Trace::FrameEnded()
+{
+    if (!IsRecording() || --s_remainingFrames)
+    {
+        return;
+    }
+
+    // Writing takes long enough to hitch the frame, and the next capture with it.
+    // The previous writer already finished, Start waits for the Idle state.
+    s_state.store(TraceState::Writing);
+    if (s_writer.joinable())
+    {
+        s_writer.join();
+    }
+    s_writer = std::thread([]{
+        write_trace();
+        s_state.store(TraceState::Idle);
+    });
+}
+
+void Trace::Finish()
+{
+    if (s_writer.joinable())
+    {
+        s_writer.join();
+    }
+}
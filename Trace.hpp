@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Captures spans from every thread for a number of frames and writes them as
+// Chrome Trace Event JSON, which chrome://tracing and Perfetto load. Spans go
+// into a preallocated buffer, so recording costs about as much as profiling.
+class Trace
+{
+public:
+    // Ignored while a capture is already running
+    static void Start(uint32_t frameCount, const std::string& path);
+    static bool IsRecording();
+
+    // GPU spans go on their own track, with start already converted to host time
+    static void AddSpan(const char *pName, std::chrono::steady_clock::time_point start, std::chrono::nanoseconds duration, bool gpu = false);
+    // Counter tracks are drawn as a graph of value over time
+    static void AddCounter(const char *pName, std::chrono::steady_clock::time_point time, int64_t value);
+    // Called once per presented frame, hands the capture to a writer thread after the last captured frame
+    static void FrameEnded();
+    // Waits for a capture that is still being written, call before exiting
+    static void Finish();
+};
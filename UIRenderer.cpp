@@ -1,5 +1,10 @@
 #include "UIRenderer.hpp"
 
+#include "DamageTracker.hpp"
+#include "DrawDataHash.hpp"
+#include "CallCounter.hpp"
+#include "Profiler.hpp"
+
 #include "imgui.h"
 
 #include <glm/glm.hpp>
@@ -11,7 +16,7 @@
 constexpr VkDeviceSize DEFAULT_INDEX_BUFFER_SIZE = 1 << 20;
 constexpr VkDeviceSize DEFAULT_VERTEX_BUFFER_SIZE = 1 << 20;
 
-struct PushConstants
+struct UIRenderer::PushConstants
 {
     glm::vec2 scale;
     glm::vec2 translate;
@@ -26,7 +31,7 @@ static std::vector<uint8_t> load_file(std::filesystem::path path)
     return ret;
 }
 
-static vk::UniqueShaderModule load_shader(vk::Device device, std::filesystem::path path)
+static std::vector<uint32_t> load_shader_code(std::filesystem::path path)
 {
     const auto raw = load_file("shaders" / path += ".spv");
 
@@ -38,61 +43,62 @@ static vk::UniqueShaderModule load_shader(vk::Device device, std::filesystem::pa
     std::vector<uint32_t> spv(raw.size() / sizeof(uint32_t));
 
     memcpy(spv.data(), raw.data(), spv.size() * sizeof(uint32_t));
+    return spv;
+}
 
+static vk::UniqueShaderModule create_shader_module(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, const std::vector<uint32_t>& spv)
+{
     const auto shaderModuleCreateInfo = vk::ShaderModuleCreateInfo()
         .setCode(spv);
 
-    return device.createShaderModuleUnique(shaderModuleCreateInfo);
+    return device.createShaderModuleUnique(shaderModuleCreateInfo, pAllocationCallbacks);
 }
 
 UIRenderer::UIRenderer()
+    :pAllocationCallbacks(nullptr), queueFamilyIndex(0), subpass(0), pAllocator(nullptr), pGpuProfiler(nullptr), pDebugUtils(nullptr), reusedRecordings(0)
 {
-    for (auto& perFrame : perFrameData)
-    {
-        perFrame.indexMemorySize = DEFAULT_INDEX_BUFFER_SIZE;
-        perFrame.vertexMemorySize = DEFAULT_VERTEX_BUFFER_SIZE;
-    }
+
 }
 
-void UIRenderer::init(vk::Device device, vma::Allocator& allocator, Uploader& uploader, vk::RenderPass renderPass, uint32_t subpass)
+void UIRenderer::loadAssets()
 {
-    pAllocator = &allocator;
-
-    auto& io = ImGui::GetIO();
-
-    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+    fontAtlas = std::async(std::launch::async, []{
+        Profiler::Scope profilerScope(Profiler::Phase::StartupFontAtlas);
 
-    int texWidth, texHeight;
-    unsigned char *pTexPixels;
-    io.Fonts->GetTexDataAsRGBA32(&pTexPixels, &texWidth, &texHeight);
-
-    const auto texExtent = vk::Extent3D{static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1};
+        int texWidth, texHeight;
+        unsigned char *pTexPixels;
+        ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pTexPixels, &texWidth, &texHeight);
+        return FontAtlas{ pTexPixels, {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1} };
+    });
 
-    const auto fontImageCreateInfo = vk::ImageCreateInfo()
-        .setImageType(vk::ImageType::e2D)
-        .setFormat(vk::Format::eR8G8B8A8Srgb)
-        .setExtent(texExtent)
-        .setMipLevels(1)
-        .setArrayLayers(1)
-        .setSamples(vk::SampleCountFlagBits::e1)
-        .setTiling(vk::ImageTiling::eOptimal)
-        .setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
-    std::tie(fontImage, fontMemory) = allocator.createImage(fontImageCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY);
+    shaderCode = std::async(std::launch::async, []{
+        Profiler::Scope profilerScope(Profiler::Phase::StartupShaders);
+        return ShaderCode{ load_shader_code("main.vert"), load_shader_code("main.frag") };
+    });
+}
 
-    uploader.uploadImage(fontImage.get(), {vk::ImageAspectFlagBits::eColor, 0, 0, 1}, texExtent, pTexPixels, vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eFragmentShader);
+void UIRenderer::init(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, uint32_t queueFamilyIndex, vma::Allocator& allocator, Uploader& uploader, GpuProfiler& gpuProfiler, const DebugUtils& debugUtils, vk::RenderPass renderPass, uint32_t subpass, vk::PipelineCache pipelineCache, uint32_t frameCount)
+{
+    this->device = device;
+    this->pAllocationCallbacks = pAllocationCallbacks;
+    this->queueFamilyIndex = queueFamilyIndex;
+    this->renderPass = renderPass;
+    this->subpass = subpass;
+    pAllocator = &allocator;
+    pGpuProfiler = &gpuProfiler;
+    pDebugUtils = &debugUtils;
 
-    const auto fontImageViewCreateInfo = vk::ImageViewCreateInfo()
-        .setImage(fontImage.get())
-        .setViewType(vk::ImageViewType::e2D)
-        .setFormat(vk::Format::eR8G8B8A8Srgb)
-        .setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
-    fontImageView = device.createImageViewUnique(fontImageViewCreateInfo);
+    if (!fontAtlas.valid())
+    {
+        loadAssets();
+    }
 
     const auto samplerCreateInfo = vk::SamplerCreateInfo()
         .setMagFilter(vk::Filter::eLinear)
         .setMinFilter(vk::Filter::eLinear)
         .setMaxLod(VK_LOD_CLAMP_NONE);
-    sampler = device.createSamplerUnique(samplerCreateInfo);
+    sampler = device.createSamplerUnique(samplerCreateInfo, pAllocationCallbacks);
+    debugUtils.setName(sampler.get(), "UI sampler");
 
     const auto immutableSamplers = std::array{ sampler.get() };
 
@@ -107,7 +113,7 @@ void UIRenderer::init(vk::Device device, vma::Allocator& allocator, Uploader& up
 
     const auto descriptorSetLayoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
         .setBindings(descriptorBindings);
-    descriptorSetLayout = device.createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo);
+    descriptorSetLayout = device.createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo, pAllocationCallbacks);
 
     const auto pushConstantRanges = std::array{
         vk::PushConstantRange()
@@ -121,7 +127,45 @@ void UIRenderer::init(vk::Device device, vma::Allocator& allocator, Uploader& up
     const auto pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
         .setPushConstantRanges(pushConstantRanges)
         .setSetLayouts(descriptorSetLayouts);
-    pipelineLayout = device.createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+    pipelineLayout = device.createPipelineLayoutUnique(pipelineLayoutCreateInfo, pAllocationCallbacks);
+
+    // Only reads members that are set by now
+    auto pipeline = std::async(std::launch::async, [this, pipelineCache]{
+        const auto code = shaderCode.get();
+        Profiler::Scope profilerScope(Profiler::Phase::StartupPipeline);
+        return create_pipeline(code, pipelineCache);
+    });
+
+    const auto atlas = fontAtlas.get();
+    const auto uploadStart = std::chrono::steady_clock::now();
+
+    auto& io = ImGui::GetIO();
+
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+
+    const auto fontImageCreateInfo = vk::ImageCreateInfo()
+        .setImageType(vk::ImageType::e2D)
+        .setFormat(vk::Format::eR8G8B8A8Srgb)
+        .setExtent(atlas.extent)
+        .setMipLevels(1)
+        .setArrayLayers(1)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+    std::tie(fontImage, fontMemory) = allocator.createImage(fontImageCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, 0, "Font atlas");
+    debugUtils.setName(fontImage.get(), "UI font image");
+
+    uploader.uploadImage(fontImage.get(), {vk::ImageAspectFlagBits::eColor, 0, 0, 1}, atlas.extent, atlas.pPixels, vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eFragmentShader);
+
+    const auto fontImageViewCreateInfo = vk::ImageViewCreateInfo()
+        .setImage(fontImage.get())
+        .setViewType(vk::ImageViewType::e2D)
+        .setFormat(vk::Format::eR8G8B8A8Srgb)
+        .setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+    fontImageView = device.createImageViewUnique(fontImageViewCreateInfo, pAllocationCallbacks);
+    debugUtils.setName(fontImageView.get(), "UI font image view");
+
+    Profiler::Record(Profiler::Phase::StartupFontUpload, uploadStart, std::chrono::steady_clock::now() - uploadStart);
 
     const auto descriptorPoolSizes = std::array{
         vk::DescriptorPoolSize()
@@ -132,7 +176,7 @@ void UIRenderer::init(vk::Device device, vma::Allocator& allocator, Uploader& up
     const auto descriptorPoolCreateInfo = vk::DescriptorPoolCreateInfo()
         .setMaxSets(1)
         .setPoolSizes(descriptorPoolSizes);
-    descriptorPool = device.createDescriptorPoolUnique(descriptorPoolCreateInfo);
+    descriptorPool = device.createDescriptorPoolUnique(descriptorPoolCreateInfo, pAllocationCallbacks);
 
     const auto descriptorSetAllocateInfo = vk::DescriptorSetAllocateInfo()
         .setDescriptorPool(descriptorPool.get())
@@ -160,14 +204,16 @@ void UIRenderer::init(vk::Device device, vma::Allocator& allocator, Uploader& up
 
     device.updateDescriptorSets(descriptorWrites, nullptr);
 
-    for (auto& perFrame : perFrameData)
-    {
-        std::tie(perFrame.indexBuffer, perFrame.indexMemory) = allocate_buffer(perFrame.indexMemorySize, vk::BufferUsageFlagBits::eIndexBuffer);
-        std::tie(perFrame.vertexBuffer, perFrame.vertexMemory) = allocate_buffer(perFrame.vertexMemorySize, vk::BufferUsageFlagBits::eVertexBuffer);
-    }
+    resize(frameCount);
 
-    const auto fragmentShader = load_shader(device, "main.frag");
-    const auto vertexShader = load_shader(device, "main.vert");
+    graphicsPipeline = pipeline.get();
+    debugUtils.setName(graphicsPipeline.get(), "UI pipeline");
+}
+
+vk::UniquePipeline UIRenderer::create_pipeline(const ShaderCode& shaderCode, vk::PipelineCache pipelineCache) const
+{
+    const auto fragmentShader = create_shader_module(device, pAllocationCallbacks, shaderCode.fragment);
+    const auto vertexShader = create_shader_module(device, pAllocationCallbacks, shaderCode.vertex);
 
     const auto shaderStages = std::array{
         vk::PipelineShaderStageCreateInfo()
@@ -254,10 +300,41 @@ void UIRenderer::init(vk::Device device, vma::Allocator& allocator, Uploader& up
         .setRenderPass(renderPass)
         .setSubpass(subpass);
 
-    graphicsPipeline = check_success(device.createGraphicsPipelineUnique(nullptr, pipelineCreateInfo)); // TODO: PipelineCache
+    return check_success(device.createGraphicsPipelineUnique(pipelineCache, pipelineCreateInfo, pAllocationCallbacks));
+}
+
+void UIRenderer::resize(uint32_t frameCount)
+{
+    const auto oldFrameCount = perFrameData.size();
+    perFrameData.resize(frameCount);
+
+    for (size_t i = oldFrameCount; i < perFrameData.size(); ++i)
+    {
+        auto& perFrame = perFrameData[i];
+        perFrame.indexMemorySize = DEFAULT_INDEX_BUFFER_SIZE;
+        perFrame.vertexMemorySize = DEFAULT_VERTEX_BUFFER_SIZE;
+        std::tie(perFrame.indexBuffer, perFrame.indexMemory) = allocate_buffer(perFrame.indexMemorySize, vk::BufferUsageFlagBits::eIndexBuffer);
+        std::tie(perFrame.vertexBuffer, perFrame.vertexMemory) = allocate_buffer(perFrame.vertexMemorySize, vk::BufferUsageFlagBits::eVertexBuffer);
+
+        const auto commandPoolCreateInfo = vk::CommandPoolCreateInfo()
+            .setQueueFamilyIndex(queueFamilyIndex);
+        perFrame.commandPool = device.createCommandPoolUnique(commandPoolCreateInfo, pAllocationCallbacks);
+
+        const auto commandBufferAllocateInfo = vk::CommandBufferAllocateInfo()
+            .setCommandPool(perFrame.commandPool.get())
+            .setLevel(vk::CommandBufferLevel::eSecondary)
+            .setCommandBufferCount(1);
+        const auto commandBuffers = device.allocateCommandBuffers(commandBufferAllocateInfo);
+        perFrame.commandBuffer = commandBuffers[0];
+
+        pDebugUtils->setName(perFrame.indexBuffer.get(), "UI index buffer %zu", i);
+        pDebugUtils->setName(perFrame.vertexBuffer.get(), "UI vertex buffer %zu", i);
+        pDebugUtils->setName(perFrame.commandBuffer, "UI command buffer %zu", i);
+    }
 }
 
-static void for_each_cmd_list(ImDrawData *pDD, std::function<void(ImDrawList *)> callback)
+template<typename F>
+void for_each_cmd_list(const ImDrawData *pDD, F&& callback)
 {
     for (int i = 0; i < pDD->CmdListsCount; ++i)
     {
@@ -265,10 +342,11 @@ static void for_each_cmd_list(ImDrawData *pDD, std::function<void(ImDrawList *)>
     }
 }
 
-void UIRenderer::render(vk::CommandBuffer commandBuffer, vk::Extent2D framebufferExtent, uint32_t frameIndex)
+void UIRenderer::render(vk::CommandBuffer commandBuffer, vk::Extent2D framebufferExtent, vk::Rect2D renderArea, uint32_t frameIndex, const ImDrawData *pDD)
 {
+    Profiler::Scope profilerScope(Profiler::Phase::UIRender);
+
     auto& perFrame = perFrameData[frameIndex];
-    const auto pDD = ImGui::GetDrawData();
 
     VkDeviceSize requiredIndexBufferSize = 0;
     VkDeviceSize requiredVertexBufferSize = 0;
@@ -282,12 +360,16 @@ void UIRenderer::render(vk::CommandBuffer commandBuffer, vk::Extent2D framebuffe
     {
         perFrame.indexMemorySize *= 2;
         std::tie(perFrame.indexBuffer, perFrame.indexMemory) = allocate_buffer(perFrame.indexMemorySize, vk::BufferUsageFlagBits::eIndexBuffer);
+        pDebugUtils->setName(perFrame.indexBuffer.get(), "UI index buffer %u", frameIndex);
+        perFrame.signature.reset();
     }
 
     while (requiredVertexBufferSize > perFrame.vertexMemorySize)
     {
         perFrame.vertexMemorySize *= 2;
         std::tie(perFrame.vertexBuffer, perFrame.vertexMemory) = allocate_buffer(perFrame.vertexMemorySize, vk::BufferUsageFlagBits::eVertexBuffer);
+        pDebugUtils->setName(perFrame.vertexBuffer.get(), "UI vertex buffer %u", frameIndex);
+        perFrame.signature.reset();
     }
 
     PushConstants pushConstants;
@@ -296,48 +378,124 @@ void UIRenderer::render(vk::CommandBuffer commandBuffer, vk::Extent2D framebuffe
     pushConstants.translate.x = -1.0f - pDD->DisplayPos.x * pushConstants.scale.x;
     pushConstants.translate.y = -1.0f - pDD->DisplayPos.y * pushConstants.scale.y;
 
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, descriptorSet, nullptr);
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline.get());
-    commandBuffer.bindIndexBuffer(perFrame.indexBuffer.get(), 0, vk::IndexType::eUint16);
-    commandBuffer.bindVertexBuffers(0, perFrame.vertexBuffer.get(), {0});
-    commandBuffer.pushConstants<PushConstants>(pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
+    // Everything that ends up in the command stream, but not the vertex and index contents
+    Hasher signatureHasher;
+    signatureHasher.update(framebufferExtent);
+    signatureHasher.update(renderArea);
+    signatureHasher.update(pushConstants);
+    signatureHasher.update(pDD->FramebufferScale);
 
     uint32_t baseIdx = 0;
     int32_t baseVtx = 0;
-    for_each_cmd_list(pDD, [&](const auto pCL)
     {
-        perFrame.indexMemory.withMap([&idx = pCL->IdxBuffer](void *pData) {
-            memcpy(pData, idx.Data, idx.size_in_bytes());
-        }, sizeof(ImDrawIdx) * baseIdx);
+        Profiler::Scope profilerScope(Profiler::Phase::CopyGeometry);
+        // Each buffer is mapped once per frame, not once per draw list
+        check_success(perFrame.indexMemory.withMap([&](void *pIndexData) {
+            check_success(perFrame.vertexMemory.withMap([&](void *pVertexData) {
+                const auto pIdx = static_cast<ImDrawIdx *>(pIndexData);
+                const auto pVtx = static_cast<ImDrawVert *>(pVertexData);
+                for_each_cmd_list(pDD, [&](const auto pCL)
+                {
+                    memcpy(pIdx + baseIdx, pCL->IdxBuffer.Data, pCL->IdxBuffer.size_in_bytes());
+                    memcpy(pVtx + baseVtx, pCL->VtxBuffer.Data, pCL->VtxBuffer.size_in_bytes());
+
+                    signatureHasher.update(pCL->CmdBuffer.Size);
+                    for (const auto& drawCommand : pCL->CmdBuffer)
+                    {
+                        signatureHasher.update(drawCommand.ClipRect);
+                        signatureHasher.update(drawCommand.TextureId);
+                        signatureHasher.update(baseIdx + drawCommand.IdxOffset);
+                        signatureHasher.update(baseVtx + drawCommand.VtxOffset);
+                        signatureHasher.update(drawCommand.ElemCount);
+                    }
+
+                    baseIdx += pCL->IdxBuffer.Size;
+                    baseVtx += pCL->VtxBuffer.Size;
+                });
+            }));
+        }));
+
+        perFrame.indexMemory.flush(0, sizeof(ImDrawIdx) * baseIdx);
+        perFrame.vertexMemory.flush(0, sizeof(ImDrawVert) * baseVtx);
+    }
+
+    const auto signature = signatureHasher.finish();
+    if (perFrame.signature == signature)
+    {
+        ++reusedRecordings;
+    }
+    else
+    {
+        record_draws(perFrame, frameIndex, framebufferExtent, renderArea, pDD, pushConstants);
+        perFrame.signature = signature;
+    }
+
+    commandBuffer.executeCommands(perFrame.commandBuffer, COUNTING_DISPATCH);
+}
+
+uint64_t UIRenderer::reusedRecordingCount() const
+{
+    return reusedRecordings;
+}
 
-        perFrame.vertexMemory.withMap([&vtx = pCL->VtxBuffer](void *pData) {
-            memcpy(pData, vtx.Data, vtx.size_in_bytes());
-        }, sizeof(ImDrawVert) * baseVtx);
+void UIRenderer::record_draws(PerFrameData& perFrame, uint32_t frameIndex, vk::Extent2D framebufferExtent, vk::Rect2D renderArea, const ImDrawData *pDD, const PushConstants& pushConstants)
+{
+    device.resetCommandPool(perFrame.commandPool.get());
+
+    const auto cb = perFrame.commandBuffer;
 
+    // No framebuffer, so the recording stays valid for every swapchain image
+    const auto inheritanceInfo = vk::CommandBufferInheritanceInfo()
+        .setRenderPass(renderPass)
+        .setSubpass(subpass);
+
+    const auto cbBeginInfo = vk::CommandBufferBeginInfo()
+        .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+        .setPInheritanceInfo(&inheritanceInfo);
+
+    // Secondary command buffers inherit no dynamic state
+    const auto viewport = vk::Viewport{
+        0.0f, 0.0f,
+        static_cast<float>(framebufferExtent.width), static_cast<float>(framebufferExtent.height),
+        0.0f, 1.0
+    };
+
+    cb.begin(cbBeginInfo);
+    cb.setViewport(0, viewport, COUNTING_DISPATCH);
+    cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, descriptorSet, nullptr, COUNTING_DISPATCH);
+    cb.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline.get(), COUNTING_DISPATCH);
+    cb.bindIndexBuffer(perFrame.indexBuffer.get(), 0, vk::IndexType::eUint16, COUNTING_DISPATCH);
+    cb.bindVertexBuffers(0, perFrame.vertexBuffer.get(), {0}, COUNTING_DISPATCH);
+    cb.pushConstants<PushConstants>(pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, pushConstants, COUNTING_DISPATCH);
+
+    uint32_t baseIdx = 0;
+    int32_t baseVtx = 0;
+    uint32_t drawListIndex = 0;
+    pDebugUtils->beginLabel(cb, "UI");
+    for_each_cmd_list(pDD, [&](const auto pCL)
+    {
+        pDebugUtils->beginLabel(cb, pCL->_OwnerName ? pCL->_OwnerName : "ImDrawList");
+        pGpuProfiler->beginDrawList(cb, frameIndex, drawListIndex);
         for (const auto& drawCommand : pCL->CmdBuffer)
         {
-            ImVec4 clip_rect;
-            clip_rect.x = (drawCommand.ClipRect.x - pDD->DisplayPos.x) * pDD->FramebufferScale.x;
-            clip_rect.y = (drawCommand.ClipRect.y - pDD->DisplayPos.y) * pDD->FramebufferScale.y;
-            clip_rect.z = (drawCommand.ClipRect.z - pDD->DisplayPos.x) * pDD->FramebufferScale.x;
-            clip_rect.w = (drawCommand.ClipRect.w - pDD->DisplayPos.y) * pDD->FramebufferScale.y;
-
-            vk::Rect2D scissor;
-            scissor.offset.x = clip_rect.x;
-            scissor.offset.y = clip_rect.y;
-            scissor.extent.width = clip_rect.z - clip_rect.x;
-            scissor.extent.height = clip_rect.w - clip_rect.y;
-
-            commandBuffer.setScissor(0, scissor);
-            commandBuffer.drawIndexed(drawCommand.ElemCount, 1, baseIdx + drawCommand.IdxOffset, baseVtx + drawCommand.VtxOffset, 0);
+            const auto scissor = intersect_rects(framebuffer_clip_rect(pDD, drawCommand.ClipRect, framebufferExtent), renderArea);
+            if (is_empty_rect(scissor))
+            {
+                continue;
+            }
+
+            cb.setScissor(0, scissor, COUNTING_DISPATCH);
+            cb.drawIndexed(drawCommand.ElemCount, 1, baseIdx + drawCommand.IdxOffset, baseVtx + drawCommand.VtxOffset, 0, COUNTING_DISPATCH);
         }
 
         baseIdx += pCL->IdxBuffer.Size;
         baseVtx += pCL->VtxBuffer.Size;
+        pGpuProfiler->endDrawList(cb, frameIndex, drawListIndex++);
+        pDebugUtils->endLabel(cb);
     });
+    pDebugUtils->endLabel(cb);
 
-    perFrame.indexMemory.flush(0, sizeof(ImDrawIdx) * baseIdx);
-    perFrame.vertexMemory.flush(0, sizeof(ImDrawVert) * baseVtx);
+    cb.end();
 }
 
 std::pair<vk::UniqueBuffer, vma::Allocation> UIRenderer::allocate_buffer(VkDeviceSize size, vk::BufferUsageFlags usage)
@@ -345,5 +503,5 @@ std::pair<vk::UniqueBuffer, vma::Allocation> UIRenderer::allocate_buffer(VkDevic
     const auto bufferCreateInfo = vk::BufferCreateInfo()
         .setSize(size)
         .setUsage(usage);
-    return pAllocator->createBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    return pAllocator->createBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, 0, "UI buffers");
 }
@@ -2,29 +2,80 @@
 
 #include "RendererUtil.hpp"
 
+#include "DebugUtils.hpp"
+#include "GpuProfiler.hpp"
 #include "Uploader.hpp"
 
+#include <future>
+#include <optional>
+
+struct ImDrawData;
+
 class UIRenderer
 {
 public:
     UIRenderer();
 
-    void init(vk::Device device, vma::Allocator& allocator, Uploader& uploader, vk::RenderPass renderPass, uint32_t subpass);
+    // Starts rasterizing the font atlas and reading the shaders on worker threads,
+    // so they overlap device creation. ImGui must be left alone until init
+    // returns. Optional, init starts them itself otherwise.
+    void loadAssets();
+    // The pipeline is compiled on a worker thread while the font atlas uploads,
+    // pipelineCache may be null
+    void init(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, uint32_t queueFamilyIndex, vma::Allocator& allocator, Uploader& uploader, GpuProfiler& gpuProfiler, const DebugUtils& debugUtils, vk::RenderPass renderPass, uint32_t subpass, vk::PipelineCache pipelineCache, uint32_t frameCount);
+    // All frames using the per-frame buffers must have completed
+    void resize(uint32_t frameCount);
 
-    void render(vk::CommandBuffer commandBuffer, vk::Extent2D framebufferExtent, uint32_t frameIndex);
+    // Draws are clipped to renderArea, anything outside it is left untouched.
+    // Must be called in a subpass begun with eSecondaryCommandBuffers.
+    void render(vk::CommandBuffer commandBuffer, vk::Extent2D framebufferExtent, vk::Rect2D renderArea, uint32_t frameIndex, const ImDrawData *pDD);
 
-private:
-    std::pair<vk::UniqueBuffer, vma::Allocation> allocate_buffer(VkDeviceSize size, vk::BufferUsageFlags usage);
+    // Frames that only refreshed vertex and index data and replayed the previous recording
+    uint64_t reusedRecordingCount() const;
 
 private:
+    struct PushConstants;
+
+    struct FontAtlas
+    {
+        // Owned by ImGui
+        unsigned char *pPixels;
+        vk::Extent3D extent;
+    };
+
+    struct ShaderCode
+    {
+        std::vector<uint32_t> vertex, fragment;
+    };
+
     struct PerFrameData {
         vk::UniqueBuffer indexBuffer, vertexBuffer;
         vma::Allocation indexMemory, vertexMemory;
         VkDeviceSize indexMemorySize, vertexMemorySize;
+
+        vk::UniqueCommandPool commandPool;
+        vk::CommandBuffer commandBuffer;
+        // Structure of the command stream currently recorded in commandBuffer
+        std::optional<uint64_t> signature;
     };
 
 private:
+    vk::UniquePipeline create_pipeline(const ShaderCode& shaderCode, vk::PipelineCache pipelineCache) const;
+    std::pair<vk::UniqueBuffer, vma::Allocation> allocate_buffer(VkDeviceSize size, vk::BufferUsageFlags usage);
+    void record_draws(PerFrameData& perFrame, uint32_t frameIndex, vk::Extent2D framebufferExtent, vk::Rect2D renderArea, const ImDrawData *pDD, const PushConstants& pushConstants);
+
+private:
+    vk::Device device;
+    const vk::AllocationCallbacks *pAllocationCallbacks;
+    uint32_t queueFamilyIndex;
+    vk::RenderPass renderPass;
+    uint32_t subpass;
     vma::Allocator *pAllocator;
+    GpuProfiler *pGpuProfiler;
+    const DebugUtils *pDebugUtils;
+
+    std::future<FontAtlas> fontAtlas;
+    std::future<ShaderCode> shaderCode;
 
     vk::UniqueImage fontImage;
     vma::Allocation fontMemory;
@@ -37,7 +88,9 @@ private:
     vk::UniqueDescriptorPool descriptorPool;
     vk::DescriptorSet descriptorSet;
 
-    std::array<PerFrameData, MAX_FRAMES_IN_FLIGHT> perFrameData;
+    std::vector<PerFrameData> perFrameData;
 
     vk::UniquePipeline graphicsPipeline;
+
+    uint64_t reusedRecordings;
 };
@@ -1,21 +1,23 @@
 #include "Uploader.hpp"
 
+#include "Profiler.hpp"
 #include "RendererUtil.hpp"
 
 constexpr VkDeviceSize STAGING_BUFFER_SIZE = 1 << 20;
 
-Uploader::Uploader(vk::Device device, uint32_t queueFamilyIndex, uint32_t queueIndex, vma::Allocator& allocator)
-    :device(device), queue(device.getQueue(queueFamilyIndex, queueIndex)), currentOffset(0), uploadInProgress(false)
+Uploader::Uploader(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, uint32_t queueFamilyIndex, SubmissionQueue& submissionQueue, vma::Allocator& allocator, const DebugUtils& debugUtils)
+    :device(device), pSubmissionQueue(&submissionQueue), pDebugUtils(&debugUtils), serial(0), currentOffset(0), uploadInProgress(false)
 {
     const auto stagingBufferCreateInfo = vk::BufferCreateInfo()
         .setSize(STAGING_BUFFER_SIZE)
         .setUsage(vk::BufferUsageFlagBits::eTransferSrc);
-    std::tie(stagingBuffer, stagingMemory) = allocator.createBuffer(stagingBufferCreateInfo, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    std::tie(stagingBuffer, stagingMemory) = allocator.createBuffer(stagingBufferCreateInfo, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, "Staging");
+    debugUtils.setName(stagingBuffer.get(), "Upload staging buffer");
 
     const auto commandPoolCreateInfo = vk::CommandPoolCreateInfo()
         .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
         .setQueueFamilyIndex(queueFamilyIndex);
-    commandPool = device.createCommandPoolUnique(commandPoolCreateInfo);
+    commandPool = device.createCommandPoolUnique(commandPoolCreateInfo, pAllocationCallbacks);
 
     const auto commandBufferAllocateInfo = vk::CommandBufferAllocateInfo()
         .setCommandPool(commandPool.get())
@@ -23,9 +25,7 @@ Uploader::Uploader(vk::Device device, uint32_t queueFamilyIndex, uint32_t queueI
         .setLevel(vk::CommandBufferLevel::ePrimary);
     const auto commandBuffers = device.allocateCommandBuffers(commandBufferAllocateInfo);
     commandBuffer = commandBuffers[0];
-
-    const auto fenceCreateInfo = vk::FenceCreateInfo();
-    fence = device.createFenceUnique(fenceCreateInfo);
+    debugUtils.setName(commandBuffer, "Upload command buffer");
 }
 
 Uploader::~Uploader()
@@ -41,25 +41,31 @@ void Uploader::begin()
     const auto stagingCommandBufferBeginInfo = vk::CommandBufferBeginInfo()
         .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     commandBuffer.begin(stagingCommandBufferBeginInfo);
+    pDebugUtils->beginLabel(commandBuffer, "Upload batch");
 }
 
 void Uploader::end()
 {
+    Profiler::Scope profilerScope(Profiler::Phase::UploadEnd);
+
+    pDebugUtils->endLabel(commandBuffer);
     commandBuffer.end();
 
     const auto commandBuffers = std::array{ commandBuffer };
 
-    const auto stagingSubmitInfo = vk::SubmitInfo()
-        .setCommandBuffers(commandBuffers);
+    SubmitBatch batch;
+    batch.commandBuffers = commandBuffers;
 
-    queue.submit(stagingSubmitInfo, fence.get());
+    serial = pSubmissionQueue->enqueue(batch);
     uploadInProgress = true;
 }
 
 vk::Result Uploader::finish()
 {
+    Profiler::Scope profilerScope(Profiler::Phase::UploadFinish);
+
     uploadInProgress = false;
-    return device.waitForFences(fence.get(), true, UINT64_MAX);
+    return pSubmissionQueue->wait(serial);
 }
 
 void Uploader::clearImage(vk::Image image, vk::ImageSubresourceRange subresourceRange, vk::ClearColorValue clearColor, vk::ImageLayout newLayout, vk::AccessFlags newAccess, vk::PipelineStageFlags newStage)
@@ -1,16 +1,20 @@
 #pragma once
 
+#include "DebugUtils.hpp"
+#include "SubmissionQueue.hpp"
 #include "vma/Allocator.hpp"
 
 class Uploader
 {
 public:
-    Uploader(vk::Device device, uint32_t queueFamilyIndex, uint32_t queueIndex, vma::Allocator& allocater);
+    Uploader(vk::Device device, const vk::AllocationCallbacks *pAllocationCallbacks, uint32_t queueFamilyIndex, SubmissionQueue& submissionQueue, vma::Allocator& allocater, const DebugUtils& debugUtils);
     //FIXME: Rule of 5
     ~Uploader();
 
     void begin();
+    // Queues the recorded uploads, they are submitted with the next flush of the SubmissionQueue
     void end();
+    // Waits for the uploads, submitting them first if nothing flushed them yet
     vk::Result finish();
 
     void clearImage(vk::Image image, vk::ImageSubresourceRange subresourceRange, vk::ClearColorValue clearColor, vk::ImageLayout newLayout, vk::AccessFlags newAccess, vk::PipelineStageFlags newStage);
@@ -18,14 +22,15 @@ public:
 
 private:
     vk::Device device;
-    vk::Queue queue;
+    SubmissionQueue *pSubmissionQueue;
+    const DebugUtils *pDebugUtils;
 
     vma::Allocation stagingMemory;
     vk::UniqueBuffer stagingBuffer;
 
     vk::UniqueCommandPool commandPool;
     vk::CommandBuffer commandBuffer;
-    vk::UniqueFence fence;
+    uint64_t serial;
 
     VkDeviceSize currentOffset;
     bool uploadInProgress;
@@ -1,9 +1,44 @@
 #include "Window.hpp"
 
+#include "Profiler.hpp"
+
 #include "imgui_impl_glfw.h"
 
+#include <atomic>
 #include <mutex>
 
+static std::atomic<uint64_t> s_eventCount;
+// steady_clock nanoseconds, 0 if no input is pending
+static std::atomic<int64_t> s_oldestInputTime;
+
+static void count_event()
+{
+    s_eventCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void count_input_event()
+{
+    count_event();
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    int64_t expected = 0;
+    s_oldestInputTime.compare_exchange_strong(expected, now, std::memory_order_relaxed);
+}
+
+static void install_event_counters(GLFWwindow *window)
+{
+    // Installed before the ImGui callbacks, which chain to these
+    glfwSetKeyCallback(window, [](GLFWwindow *, int, int, int, int){ count_input_event(); });
+    glfwSetCharCallback(window, [](GLFWwindow *, unsigned int){ count_input_event(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow *, int, int, int){ count_input_event(); });
+    glfwSetScrollCallback(window, [](GLFWwindow *, double, double){ count_input_event(); });
+    glfwSetCursorPosCallback(window, [](GLFWwindow *, double, double){ count_input_event(); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow *, int){ count_event(); });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow *, int, int){ count_event(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow *){ count_event(); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow *, int){ count_event(); });
+}
+
 Window::Window()
 {
     static std::once_flag s_init;
@@ -16,6 +51,7 @@ Window::Window()
     glfwWindowHint(GLFW_MAXIMIZED, true);
     window = glfwCreateWindow(800, 600, "vkwars", nullptr, nullptr);
 
+    install_event_counters(window);
     ImGui_ImplGlfw_InitForVulkan(window, true);
 }
 
@@ -42,6 +78,24 @@ bool Window::shouldClose() const noexcept
 
 void Window::PollEvents()
 {
+    Profiler::Scope profilerScope(Profiler::Phase::PollEvents);
     glfwPollEvents();
     ImGui_ImplGlfw_NewFrame();
+}
+
+void Window::WaitEvents(double timeout)
+{
+    glfwWaitEventsTimeout(timeout);
+    ImGui_ImplGlfw_NewFrame();
+}
+
+uint64_t Window::EventCount()
+{
+    return s_eventCount.load(std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::time_point Window::TakeInputTime()
+{
+    const auto time = s_oldestInputTime.exchange(0, std::memory_order_relaxed);
+    return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(time));
 }
\ No newline at end of file
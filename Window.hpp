@@ -3,6 +3,8 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+
 class Window
 {
 public:
@@ -19,6 +21,14 @@ public:
     bool shouldClose() const noexcept;
 
     static void PollEvents();
+    // Blocks until an event arrives or timeout seconds passed
+    static void WaitEvents(double timeout);
+    // Number of input and window events received so far
+    static uint64_t EventCount();
+    // When the oldest input event not taken yet was received, or a default
+    // time_point if there was none. GLFW has no OS timestamps, so events are
+    // stamped when PollEvents or WaitEvents dispatches them.
+    static std::chrono::steady_clock::time_point TakeInputTime();
 
 private:
     GLFWwindow *window;
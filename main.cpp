@@ -1,8 +1,80 @@
+#include "AllocationCounter.hpp"
+#include "CallCounter.hpp"
+#include "FramePacer.hpp"
+#include "HostAllocator.hpp"
+#include "IdleTracker.hpp"
+#include "Profiler.hpp"
+#include "RenderThread.hpp"
 #include "Renderer.hpp"
+#include "Trace.hpp"
 #include "Window.hpp"
 
 #include "imgui.h"
 
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+
+constexpr auto NON_BLOCKING_WAIT_TIMEOUT = std::chrono::milliseconds(1);
+// Percentiles only change visibly a few times a second, recomputing them every frame would be wasted
+constexpr auto PROFILER_REFRESH_INTERVAL = std::chrono::milliseconds(250);
+constexpr uint32_t DEFAULT_TRACE_FRAMES = 120;
+// Frames before the renderer's buffers and containers are expected to have grown to size
+constexpr uint32_t ALLOCATION_CHECK_WARMUP_FRAMES = 100;
+
+// Where F12 and --trace write captures
+static std::string s_tracePath = "vkwars.trace.json";
+static uint32_t s_traceFrames = DEFAULT_TRACE_FRAMES;
+// Where the memory window and --memory-dump write allocator statistics
+static std::string s_memoryDumpPath = "vkwars.memory.json";
+
+static void print_usage(const char *pProgram)
+{
+    fprintf(stderr, "Usage: %s [--low-latency | --non-blocking | [--idle] [--render-thread]] [--frames-in-flight N|auto] [--skip-redundant-frames] [--partial-redraw] [--gpu-timestamps] [--pipeline-statistics] [--debug-labels] [--count-api-calls] [--telemetry] [--host-allocator count|arena] [--present latency|throughput|power] [--swapchain-images N] [--trace FILE] [--trace-frames N] [--memory-dump FILE] [--pipeline-cache FILE] [--headless [--frames N] [--size WIDTHxHEIGHT] [--vsync-hz HZ] [--check-allocations]]\n", pProgram);
+}
+
+// Returns the exit code, so callers can return it directly
+static int invalid_value(const char *pProgram, const char *pOption, const char *pValue)
+{
+    fprintf(stderr, "Invalid value '%s' for %s\n", pValue, pOption);
+    print_usage(pProgram);
+    return 1;
+}
+
+// The whole text must be a decimal number of at least min
+static bool parse_uint(const char *pText, uint32_t min, uint32_t *pValue)
+{
+    if (!isdigit(static_cast<unsigned char>(*pText)))
+    {
+        return false;
+    }
+
+    char *pEnd;
+    errno = 0;
+    const auto value = strtoul(pText, &pEnd, 10);
+    if (*pEnd || errno || value < min || value > UINT32_MAX)
+    {
+        return false;
+    }
+    *pValue = static_cast<uint32_t>(value);
+    return true;
+}
+
+static bool parse_extent(const char *pText, vk::Extent2D *pExtent)
+{
+    const std::string text(pText);
+    const auto separator = text.find('x');
+    return separator != std::string::npos && parse_uint(text.substr(0, separator).c_str(), 1, &pExtent->width)
+        && parse_uint(text.substr(separator + 1).c_str(), 1, &pExtent->height);
+}
+
 void ShowBackendCheckerWindow(bool* p_open = nullptr)
 {
     if (!ImGui::Begin("Dear ImGui Backend Checker", p_open))
@@ -54,29 +126,818 @@ void ShowBackendCheckerWindow(bool* p_open = nullptr)
     ImGui::End();
 }
 
-int main()
+static void show_swapchain_window(Renderer& renderer)
 {
-    ImGui::CreateContext();
-    ImGui::GetIO().FontGlobalScale *= 2;
+    if (!ImGui::Begin("Swapchain"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto& policy = renderer.swapchainPolicy();
+
+    const char *presentPreferences[] = { "Latency", "Throughput", "Power" };
+    auto presentPreference = static_cast<int>(policy.presentPreference);
+    if (ImGui::Combo("Present preference", &presentPreference, presentPreferences, IM_ARRAYSIZE(presentPreferences)))
+    {
+        renderer.setPresentPreference(static_cast<PresentPreference>(presentPreference));
+    }
+
+    auto imageCount = static_cast<int>(policy.imageCount);
+    if (ImGui::SliderInt("Image count", &imageCount, 0, 8, imageCount ? "%d" : "default"))
+    {
+        renderer.setSwapchainImageCount(static_cast<uint32_t>(imageCount));
+    }
+
+    ImGui::Text("Present mode: %s, %u images", vk::to_string(renderer.presentMode()).c_str(), renderer.swapchainImageCount());
+
+    ImGui::End();
+}
+
+static void show_profiler_window()
+{
+    Profiler::Scope profilerScope(Profiler::Phase::Overlay);
+
+    constexpr auto PHASE_COUNT = static_cast<size_t>(Profiler::Phase::Count);
+    static std::array<Profiler::Summary, PHASE_COUNT> summaries;
+    static std::array<float, Profiler::HISTORY_SIZE> history;
+    static size_t historySize = 0;
+    static int plottedPhase = static_cast<int>(Profiler::Phase::BuildUI);
+    static std::chrono::steady_clock::time_point lastRefresh;
+
+    if (!ImGui::Begin("Frame phases"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastRefresh >= PROFILER_REFRESH_INTERVAL)
+    {
+        for (size_t i = 0; i < PHASE_COUNT; ++i)
+        {
+            summaries[i] = Profiler::Summarize(static_cast<Profiler::Phase>(i));
+        }
+        historySize = Profiler::History(static_cast<Profiler::Phase>(plottedPhase), history);
+        lastRefresh = now;
+    }
+
+    const auto ms = [](std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    ImGui::Columns(5, "phases");
+    ImGui::Text("Phase (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("p50");
+    ImGui::NextColumn();
+    ImGui::Text("p90");
+    ImGui::NextColumn();
+    ImGui::Text("p99");
+    ImGui::NextColumn();
+    ImGui::Text("max");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        const auto& summary = summaries[i];
+        ImGui::Text("%s", Profiler::Name(static_cast<Profiler::Phase>(i)));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ms(summary.median));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ms(summary.p90));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ms(summary.p99));
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", ms(summary.max));
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    const auto phaseName = [](void *, int index, const char **pText) {
+        *pText = Profiler::Name(static_cast<Profiler::Phase>(index));
+        return true;
+    };
+    if (ImGui::Combo("Plot", &plottedPhase, phaseName, nullptr, static_cast<int>(PHASE_COUNT)))
+    {
+        lastRefresh = {};
+    }
+    ImGui::PlotLines("##history", history.data(), static_cast<int>(historySize), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
+
+    ImGui::End();
+}
+
+static void print_pipeline_statistics(const GpuProfiler::FrameStatistics& statistics)
+{
+    printf("UI pipeline statistics: %llu vertices, %llu primitives (%llu after clipping), %llu fragments, overdraw %.2f\n",
+        static_cast<unsigned long long>(statistics.total.inputVertices), static_cast<unsigned long long>(statistics.total.inputPrimitives),
+        static_cast<unsigned long long>(statistics.total.clippedPrimitives), static_cast<unsigned long long>(statistics.total.fragmentInvocations), statistics.overdraw());
+}
+
+static void show_pipeline_statistics_window(const Renderer& renderer)
+{
+    if (!ImGui::Begin("Pipeline statistics"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto& statistics = renderer.pipelineStatistics();
+    ImGui::Text("Overdraw: %.2f fragments per pixel", statistics.overdraw());
+
+    ImGui::Columns(5, "drawLists");
+    ImGui::Text("Draw list");
+    ImGui::NextColumn();
+    ImGui::Text("Vertices");
+    ImGui::NextColumn();
+    ImGui::Text("Primitives");
+    ImGui::NextColumn();
+    ImGui::Text("Clipped");
+    ImGui::NextColumn();
+    ImGui::Text("Fragments");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    const auto row = [](const char *pName, const GpuProfiler::PipelineStatistics& drawList) {
+        ImGui::Text("%s", pName);
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(drawList.inputVertices));
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(drawList.inputPrimitives));
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(drawList.clippedPrimitives));
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(drawList.fragmentInvocations));
+        ImGui::NextColumn();
+    };
+
+    row("Total", statistics.total);
+    for (uint32_t i = 0; i < statistics.drawListCount; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "#%u", i);
+        row(name, statistics.drawLists[i]);
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
+
+static void show_latency_window(const Renderer& renderer)
+{
+    if (!ImGui::Begin("Latency"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto& histogram = renderer.inputToPresentLatency();
+    const auto milliseconds = [](std::chrono::nanoseconds duration) {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    };
+
+    ImGui::Text("Input to submit: %.2fms", milliseconds(renderer.inputToSubmitLatency()));
+    ImGui::Text("Input to %s: p50 %.0fms, p90 %.0fms, p99 %.0fms (%llu frames)", renderer.presentWaitEnabled() ? "present" : "GPU done",
+        milliseconds(histogram.percentile(50)), milliseconds(histogram.percentile(90)), milliseconds(histogram.percentile(99)), static_cast<unsigned long long>(histogram.count()));
+
+    std::array<float, LatencyHistogram::BUCKET_COUNT> buckets;
+    histogram.copyBuckets(buckets);
+    ImGui::PlotHistogram("##latency", buckets.data(), static_cast<int>(buckets.size()), 0, "1ms buckets", 0.0f, FLT_MAX, ImVec2(0, 80));
+
+    ImGui::End();
+}
+
+static void print_call_counts()
+{
+    const auto counts = CallCounter::LastFrame();
+    printf("API calls in the last frame:");
+    for (size_t i = 0; i < CallCounter::CALL_COUNT; ++i)
+    {
+        printf(" %s %u", CallCounter::Name(static_cast<CallCounter::Call>(i)), counts[i]);
+    }
+    printf("\n");
+}
+
+static void show_call_counter_window()
+{
+    if (!ImGui::Begin("API calls"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto counts = CallCounter::LastFrame();
+    ImGui::Columns(2, "calls");
+    ImGui::Text("Call");
+    ImGui::NextColumn();
+    ImGui::Text("Per frame");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (size_t i = 0; i < CallCounter::CALL_COUNT; ++i)
+    {
+        ImGui::Text("%s", CallCounter::Name(static_cast<CallCounter::Call>(i)));
+        ImGui::NextColumn();
+        ImGui::Text("%u", counts[i]);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
+
+static void show_memory_window(const Renderer& renderer)
+{
+    if (!ImGui::Begin("GPU memory"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    constexpr auto MB = 1024.0 * 1024.0;
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    const auto heapCount = renderer.memoryBudgets(budgets);
+
+    ImGui::Columns(4, "heaps");
+    ImGui::Text("Heap (MB)");
+    ImGui::NextColumn();
+    ImGui::Text("Allocated");
+    ImGui::NextColumn();
+    ImGui::Text("Usage");
+    ImGui::NextColumn();
+    ImGui::Text("Budget");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (uint32_t i = 0; i < heapCount; ++i)
+    {
+        ImGui::Text("#%u", i);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", budgets[i].allocationBytes / MB);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", budgets[i].usage / MB);
+        ImGui::NextColumn();
+        ImGui::ProgressBar(budgets[i].budget ? static_cast<float>(budgets[i].usage) / budgets[i].budget : 0.0f, ImVec2(-1, 0));
+        ImGui::SameLine();
+        ImGui::Text("%.1f", budgets[i].budget / MB);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    ImGui::Columns(3, "tags");
+    ImGui::Text("Owner");
+    ImGui::NextColumn();
+    ImGui::Text("Allocations");
+    ImGui::NextColumn();
+    ImGui::Text("MB");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (const auto& tag : renderer.memoryTags())
+    {
+        ImGui::Text("%s", tag.pName);
+        ImGui::NextColumn();
+        ImGui::Text("%u", tag.allocationCount.load(std::memory_order_relaxed));
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", tag.bytes.load(std::memory_order_relaxed) / MB);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    if (ImGui::Button("Dump JSON"))
+    {
+        renderer.dumpMemoryStatistics(s_memoryDumpPath);
+    }
+    ImGui::SameLine();
+    ImGui::Text("%s", s_memoryDumpPath.c_str());
+
+    ImGui::End();
+}
+
+static void print_host_allocations()
+{
+    const auto statistics = HostAllocator::Collect();
+    printf("Driver host allocations:");
+    for (size_t i = 0; i < HostAllocator::SCOPE_COUNT; ++i)
+    {
+        printf(" %s %llu calls (%llu last frame) %llu bytes live,", HostAllocator::ScopeName(static_cast<vk::SystemAllocationScope>(i)),
+            static_cast<unsigned long long>(statistics[i].calls), static_cast<unsigned long long>(statistics[i].lastFrameCalls), static_cast<unsigned long long>(statistics[i].liveBytes));
+    }
+    printf(" %llu arena overflows\n", static_cast<unsigned long long>(HostAllocator::ArenaOverflows()));
+}
+
+static void show_host_allocator_window()
+{
+    if (!ImGui::Begin("Host allocations"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const auto statistics = HostAllocator::Collect();
+    ImGui::Columns(5, "scopes");
+    ImGui::Text("Scope");
+    ImGui::NextColumn();
+    ImGui::Text("Calls");
+    ImGui::NextColumn();
+    ImGui::Text("Live KB");
+    ImGui::NextColumn();
+    ImGui::Text("Calls/frame");
+    ImGui::NextColumn();
+    ImGui::Text("KB/frame");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for (size_t i = 0; i < HostAllocator::SCOPE_COUNT; ++i)
+    {
+        const auto& scope = statistics[i];
+        ImGui::Text("%s", HostAllocator::ScopeName(static_cast<vk::SystemAllocationScope>(i)));
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(scope.calls));
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", scope.liveBytes / 1024.0);
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(scope.lastFrameCalls));
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", scope.lastFrameBytes / 1024.0);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Text("Arena overflows: %llu", static_cast<unsigned long long>(HostAllocator::ArenaOverflows()));
+
+    ImGui::End();
+}
+
+// Only pass the renderer when it is driven from this thread
+static void build_ui(Renderer *pRenderer = nullptr)
+{
+    Profiler::Scope profilerScope(Profiler::Phase::BuildUI);
+    ImGui::NewFrame();
+    if (ImGui::IsKeyPressed(GLFW_KEY_F12, false))
+    {
+        Trace::Start(s_traceFrames, s_tracePath);
+    }
+    ImGui::ShowDemoWindow();
+    ImGui::ShowMetricsWindow();
+    ShowBackendCheckerWindow();
+    show_profiler_window();
+    if (CallCounter::IsEnabled())
+    {
+        show_call_counter_window();
+    }
+    if (HostAllocator::IsInstalled())
+    {
+        show_host_allocator_window();
+    }
+    if (pRenderer)
+    {
+        show_swapchain_window(*pRenderer);
+        show_memory_window(*pRenderer);
+        show_latency_window(*pRenderer);
+        if (pRenderer->pipelineStatisticsEnabled())
+        {
+            show_pipeline_statistics_window(*pRenderer);
+        }
+    }
+    ImGui::Render();
+}
+
+static void render_frame(Renderer& renderer, std::optional<RenderThread>& renderThread, std::chrono::steady_clock::time_point inputTime = {})
+{
+    if (renderThread)
+    {
+        renderThread->submit(ImGui::GetDrawData(), inputTime);
+    }
+    else
+    {
+        renderer.render(ImGui::GetDrawData(), inputTime);
+    }
+}
+
+// Steps on worker threads overlap, so they add up to more than the total
+static void print_startup_times()
+{
+    printf("startup");
+    // The startup phases come last
+    for (auto i = static_cast<size_t>(Profiler::Phase::Startup); i < static_cast<size_t>(Profiler::Phase::Count); ++i)
+    {
+        const auto phase = static_cast<Profiler::Phase>(i);
+        printf(" | %s %.1fms", Profiler::Name(phase), std::chrono::duration<double, std::milli>(Profiler::Last(phase)).count());
+    }
+    printf("\n");
+}
+
+static void print_latency(const Renderer& renderer)
+{
+    printf("input-to-submit latency %.3fms\n", std::chrono::duration<double, std::milli>(renderer.inputToSubmitLatency()).count());
+
+    const auto& histogram = renderer.inputToPresentLatency();
+    if (histogram.count())
+    {
+        const auto milliseconds = [](std::chrono::nanoseconds duration) {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        };
+        printf("input-to-%s latency p50 %.0fms, p90 %.0fms, p99 %.0fms over %llu frames\n", renderer.presentWaitEnabled() ? "present" : "GPU-done",
+            milliseconds(histogram.percentile(50)), milliseconds(histogram.percentile(90)), milliseconds(histogram.percentile(99)), static_cast<unsigned long long>(histogram.count()));
+    }
+}
+
+// Waits for the frame slot and image first and samples input as late as possible
+static void run_low_latency(Window& window, Renderer& renderer)
+{
+    FramePacer pacer;
+    while (!window.shouldClose())
+    {
+        if (!renderer.beginFrame())
+        {
+            // Keeps resizes and close requests coming while the swapchain is out of date
+            Window::PollEvents();
+            continue;
+        }
+        pacer.frameBegun();
+        pacer.waitForInputDeadline();
+
+        Window::PollEvents();
+        pacer.inputSampled();
+        const auto inputTime = Window::TakeInputTime();
+
+        build_ui(&renderer);
+
+        renderer.endFrame(ImGui::GetDrawData(), inputTime);
+        pacer.frameSubmitted();
+    }
+}
+
+// Never blocks on the GPU or the swapchain for long, keeps polling input and
+// rebuilding the UI instead so the frame that gets submitted is the freshest
+static void run_non_blocking(Window& window, Renderer& renderer)
+{
+    uint64_t staleFrames = 0;
+    while (!window.shouldClose())
+    {
+        Window::PollEvents();
+        const auto inputTime = Window::TakeInputTime();
+
+        build_ui(&renderer);
+
+        switch (renderer.tryBeginFrame(NON_BLOCKING_WAIT_TIMEOUT))
+        {
+        case Renderer::FrameStatus::Ready:
+            renderer.endFrame(ImGui::GetDrawData(), inputTime);
+            break;
+        case Renderer::FrameStatus::NotReady:
+            ++staleFrames;
+            break;
+        case Renderer::FrameStatus::Rebuilt:
+            break;
+        }
+    }
+
+    printf("%llu UI frames built while waiting, blocked %.3fms on the GPU and %.3fms on the swapchain\n", static_cast<unsigned long long>(staleFrames),
+        std::chrono::duration<double, std::milli>(renderer.gpuWaitTime()).count(), std::chrono::duration<double, std::milli>(renderer.swapchainWaitTime()).count());
+}
 
+static void run_windowed(const RendererOptions& options, bool useRenderThread, bool idleWait, bool lowLatency, bool nonBlocking)
+{
     Window window;
 
     Renderer renderer([&window](uint32_t *pCount){ return window.getVulkanExtensions(pCount); }, [&window](VkInstance instance, VkAllocationCallbacks *allocator, VkSurfaceKHR *pSurface){
         return window.getVulkanSurface(instance, allocator, pSurface);
-    });
+    }, options);
+    print_startup_times();
+
+    if (lowLatency)
+    {
+        run_low_latency(window, renderer);
+        print_latency(renderer);
+        return;
+    }
+    if (nonBlocking)
+    {
+        run_non_blocking(window, renderer);
+        print_latency(renderer);
+        return;
+    }
 
+    std::optional<RenderThread> renderThread;
+    if (useRenderThread)
+    {
+        renderThread.emplace(renderer);
+    }
+
+    IdleTracker idleTracker;
     while (!window.shouldClose())
     {
-        Window::PollEvents();
+        if (idleWait && idleTracker.isSettled())
+        {
+            Window::WaitEvents(idleTracker.timeout());
+            idleTracker.countWakeup();
+        }
+        else
+        {
+            Window::PollEvents();
+        }
+        const auto inputTime = Window::TakeInputTime();
 
-        ImGui::NewFrame();
-        ImGui::ShowDemoWindow();
-        ImGui::ShowMetricsWindow();
-        ShowBackendCheckerWindow();
-        ImGui::Render();
+        build_ui(renderThread ? nullptr : &renderer);
 
-        renderer.render();
+        if (!idleWait || idleTracker.frameChanged(ImGui::GetDrawData(), Window::EventCount()))
+        {
+            render_frame(renderer, renderThread, inputTime);
+        }
+    }
+
+    if (renderThread)
+    {
+        renderThread->flush();
+    }
+    print_latency(renderer);
+
+    if (idleWait)
+    {
+        printf("%llu frames rendered, %llu idle wakeups\n", static_cast<unsigned long long>(idleTracker.renderedFrameCount()), static_cast<unsigned long long>(idleTracker.wakeupCount()));
+    }
+}
+
+// Returns false if checkAllocations is set and rendering a steady-state frame hit the heap
+static bool run_headless(const RendererOptions& options, bool useRenderThread, vk::Extent2D extent, uint32_t frameCount, std::chrono::nanoseconds presentInterval, bool checkAllocations, bool dumpMemory)
+{
+    auto& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+    io.DeltaTime = 1.0f / 60.0f;
+
+    Renderer renderer(extent, presentInterval, options);
+    print_startup_times();
+
+    std::optional<RenderThread> renderThread;
+    if (useRenderThread)
+    {
+        renderThread.emplace(renderer);
+    }
+
+    uint64_t steadyAllocations = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        build_ui();
+
+        // Only the renderer is checked, ImGui itself may allocate while building the UI
+        const auto allocationsBefore = allocation_count();
+        render_frame(renderer, renderThread);
+        if (i >= ALLOCATION_CHECK_WARMUP_FRAMES)
+        {
+            steadyAllocations += allocation_count() - allocationsBefore;
+        }
+    }
+    if (renderThread)
+    {
+        renderThread->flush();
+    }
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u frames in %.3fs (%.1f fps, %.3fms/frame), %u frames in flight, %llu skipped\n", frameCount, elapsed, frameCount / elapsed, 1000.0 * elapsed / frameCount, renderer.framesInFlight(), static_cast<unsigned long long>(renderer.skippedFrameCount()));
+    if (renderer.pipelineStatisticsEnabled())
+    {
+        print_pipeline_statistics(renderer.pipelineStatistics());
+    }
+    if (CallCounter::IsEnabled())
+    {
+        print_call_counts();
+    }
+    if (HostAllocator::IsInstalled())
+    {
+        print_host_allocations();
+    }
+    if (dumpMemory && renderer.dumpMemoryStatistics(s_memoryDumpPath))
+    {
+        printf("Wrote memory statistics to %s\n", s_memoryDumpPath.c_str());
+    }
+
+    if (checkAllocations)
+    {
+        printf("%llu heap allocations in %u steady-state frames\n", static_cast<unsigned long long>(steadyAllocations), frameCount - ALLOCATION_CHECK_WARMUP_FRAMES);
+        return !steadyAllocations;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    RendererOptions options;
+    bool useRenderThread = false;
+    bool idleWait = false;
+    bool lowLatency = false;
+    bool nonBlocking = false;
+    bool headless = false;
+    bool checkAllocations = false;
+    bool traceAtStartup = false;
+    bool dumpMemory = false;
+    vk::Extent2D headlessExtent{1920, 1080};
+    uint32_t headlessFrameCount = 1000;
+    std::chrono::nanoseconds headlessPresentInterval{0};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--headless"))
+        {
+            headless = true;
+        }
+        else if (!strcmp(argv[i], "--check-allocations"))
+        {
+            checkAllocations = true;
+        }
+        else if (!strcmp(argv[i], "--render-thread"))
+        {
+            useRenderThread = true;
+        }
+        else if (!strcmp(argv[i], "--low-latency"))
+        {
+            lowLatency = true;
+        }
+        else if (!strcmp(argv[i], "--non-blocking"))
+        {
+            nonBlocking = true;
+        }
+        else if (!strcmp(argv[i], "--idle"))
+        {
+            idleWait = true;
+        }
+        else if (!strcmp(argv[i], "--skip-redundant-frames"))
+        {
+            options.skipRedundantFrames = true;
+        }
+        else if (!strcmp(argv[i], "--partial-redraw"))
+        {
+            options.partialRedraw = true;
+        }
+        else if (!strcmp(argv[i], "--gpu-timestamps"))
+        {
+            options.gpuTimestamps = true;
+        }
+        else if (!strcmp(argv[i], "--pipeline-statistics"))
+        {
+            options.pipelineStatistics = true;
+        }
+        else if (!strcmp(argv[i], "--debug-labels"))
+        {
+            options.debugUtils = true;
+        }
+        else if (!strcmp(argv[i], "--telemetry"))
+        {
+            options.telemetry = true;
+        }
+        else if (!strcmp(argv[i], "--count-api-calls"))
+        {
+            CallCounter::SetEnabled(true);
+        }
+        else if (!strcmp(argv[i], "--host-allocator") && i + 1 < argc)
+        {
+            ++i;
+            if (!strcmp(argv[i], "count"))
+            {
+                options.pAllocationCallbacks = HostAllocator::Callbacks(HostAllocator::Mode::Counting);
+            }
+            else if (!strcmp(argv[i], "arena"))
+            {
+                options.pAllocationCallbacks = HostAllocator::Callbacks(HostAllocator::Mode::Arena);
+            }
+            else
+            {
+                fprintf(stderr, "Invalid host allocator '%s', expected count or arena\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--frames-in-flight") && i + 1 < argc)
+        {
+            if (!strcmp(argv[++i], "auto"))
+            {
+                options.autoTuneFramesInFlight = true;
+            }
+            else if (!parse_uint(argv[i], 1, &options.framesInFlight))
+            {
+                return invalid_value(argv[0], "--frames-in-flight", argv[i]);
+            }
+        }
+        else if (!strcmp(argv[i], "--present") && i + 1 < argc)
+        {
+            ++i;
+            if (!strcmp(argv[i], "latency"))
+            {
+                options.swapchain.presentPreference = PresentPreference::Latency;
+            }
+            else if (!strcmp(argv[i], "throughput"))
+            {
+                options.swapchain.presentPreference = PresentPreference::Throughput;
+            }
+            else if (!strcmp(argv[i], "power"))
+            {
+                options.swapchain.presentPreference = PresentPreference::Power;
+            }
+            else
+            {
+                fprintf(stderr, "Invalid present preference '%s', expected latency, throughput or power\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--swapchain-images") && i + 1 < argc)
+        {
+            if (!parse_uint(argv[++i], 0, &options.swapchain.imageCount))
+            {
+                return invalid_value(argv[0], "--swapchain-images", argv[i]);
+            }
+        }
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+        {
+            s_tracePath = argv[++i];
+            traceAtStartup = true;
+        }
+        else if (!strcmp(argv[i], "--pipeline-cache") && i + 1 < argc)
+        {
+            options.pipelineCachePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--memory-dump") && i + 1 < argc)
+        {
+            s_memoryDumpPath = argv[++i];
+            dumpMemory = true;
+        }
+        else if (!strcmp(argv[i], "--trace-frames") && i + 1 < argc)
+        {
+            if (!parse_uint(argv[++i], 1, &s_traceFrames))
+            {
+                return invalid_value(argv[0], "--trace-frames", argv[i]);
+            }
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            if (!parse_uint(argv[++i], 1, &headlessFrameCount))
+            {
+                return invalid_value(argv[0], "--frames", argv[i]);
+            }
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            if (!parse_extent(argv[++i], &headlessExtent))
+            {
+                return invalid_value(argv[0], "--size", argv[i]);
+            }
+        }
+        else if (!strcmp(argv[i], "--vsync-hz") && i + 1 < argc)
+        {
+            char *pEnd;
+            const auto hz = strtod(argv[++i], &pEnd);
+            // 0 turns the simulated vsync off
+            if (pEnd == argv[i] || *pEnd || !std::isfinite(hz) || hz < 0)
+            {
+                return invalid_value(argv[0], "--vsync-hz", argv[i]);
+            }
+            headlessPresentInterval = std::chrono::nanoseconds(hz > 0 ? static_cast<int64_t>(1e9 / hz) : 0);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (lowLatency && (nonBlocking || idleWait || useRenderThread || headless))
+    {
+        fprintf(stderr, "--low-latency cannot be combined with --non-blocking, --idle, --render-thread or --headless\n");
+        return 1;
+    }
+    if (nonBlocking && (idleWait || useRenderThread || headless))
+    {
+        fprintf(stderr, "--non-blocking cannot be combined with --idle, --render-thread or --headless\n");
+        return 1;
+    }
+
+    if (checkAllocations && (!headless || useRenderThread || headlessFrameCount <= ALLOCATION_CHECK_WARMUP_FRAMES))
+    {
+        fprintf(stderr, "--check-allocations requires --headless without --render-thread and more than %u frames\n", ALLOCATION_CHECK_WARMUP_FRAMES);
+        return 1;
+    }
+
+    // Must be installed before the context is created
+    count_imgui_allocations();
+    ImGui::CreateContext();
+    ImGui::GetIO().FontGlobalScale *= 2;
+
+    // Started before the renderer, so its initial uploads are captured too
+    if (traceAtStartup)
+    {
+        Trace::Start(s_traceFrames, s_tracePath);
+    }
+
+    auto success = true;
+    if (headless)
+    {
+        success = run_headless(options, useRenderThread, headlessExtent, headlessFrameCount, headlessPresentInterval, checkAllocations, dumpMemory);
+    }
+    else
+    {
+        run_windowed(options, useRenderThread, idleWait, lowLatency, nonBlocking);
     }
 
+    Trace::Finish();
     ImGui::DestroyContext();
+    return success ? 0 : 1;
 }
@@ -4,38 +4,37 @@ namespace vma
 {
 
 Allocation::Allocation()
-    :parent(nullptr), handle(nullptr)
+    :parent(nullptr), handle(nullptr), pTag(nullptr), size(0)
 {
 
 }
 
-Allocation::Allocation(VmaAllocator parent, VmaAllocation handle)
-    :parent(parent), handle(handle)
+Allocation::Allocation(VmaAllocator parent, VmaAllocation handle, TagStatistics *pTag, VkDeviceSize size)
+    :parent(parent), handle(handle), pTag(pTag), size(size)
 {
-
+    if (pTag)
+    {
+        pTag->allocationCount.fetch_add(1, std::memory_order_relaxed);
+        pTag->bytes.fetch_add(size, std::memory_order_relaxed);
+    }
 }
 
 Allocation::Allocation(Allocation&& other)
-    :parent(other.parent), handle(other.handle)
+    :parent(other.parent), handle(other.handle), pTag(other.pTag), size(other.size)
 {
     other.parent = nullptr;
     other.handle = nullptr;
+    other.pTag = nullptr;
 }
 
 Allocation::~Allocation()
 {
-    if (parent)
-    {
-        vmaFreeMemory(parent, handle);
-    }
+    free();
 }
 
 Allocation& Allocation::operator=(Allocation&& other)
 {
-    if (parent)
-    {
-        vmaFreeMemory(parent, handle);
-    }
+    free();
 
     parent = other.parent;
     other.parent = nullptr;
@@ -43,25 +42,30 @@ Allocation& Allocation::operator=(Allocation&& other)
     handle = other.handle;
     other.handle = nullptr;
 
+    pTag = other.pTag;
+    other.pTag = nullptr;
+    size = other.size;
+
     return *this;
 }
 
 vk::Result Allocation::flush(VkDeviceSize offset, VkDeviceSize size)
 {
+    CallCounter::Add(CallCounter::Call::FlushAllocation);
     return vk::Result(vmaFlushAllocation(parent, handle, offset, size));
 }
 
-vk::Result Allocation::withMap(std::function<void(void*)> func, VkDeviceSize offset)
+void Allocation::free()
 {
-    void *pData;
-    const auto ret = vmaMapMemory(parent, handle, &pData);
-    if (!ret)
+    if (parent)
+    {
+        vmaFreeMemory(parent, handle);
+    }
+    if (pTag)
     {
-        pData = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pData) + offset);
-        func(pData);
-        vmaUnmapMemory(parent, handle);
+        pTag->allocationCount.fetch_sub(1, std::memory_order_relaxed);
+        pTag->bytes.fetch_sub(size, std::memory_order_relaxed);
     }
-    return vk::Result(ret);
 }
 
 }
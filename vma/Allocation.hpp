@@ -2,18 +2,28 @@
 
 #include "vk_mem_alloc.h"
 
+#include "../CallCounter.hpp"
+
 #include <vulkan/vulkan.hpp>
 
-#include <functional>
+#include <atomic>
 
 namespace vma
 {
 
+// Live allocations of one owner, see Allocator::tagStatistics
+struct TagStatistics
+{
+    const char *pName;
+    std::atomic<uint32_t> allocationCount;
+    std::atomic<VkDeviceSize> bytes;
+};
+
 class Allocation
 {
 public:
     Allocation();
-    Allocation(VmaAllocator parent, VmaAllocation handle);
+    Allocation(VmaAllocator parent, VmaAllocation handle, TagStatistics *pTag = nullptr, VkDeviceSize size = 0);
     Allocation(const Allocation&) = delete;
     Allocation(Allocation&&);
     ~Allocation();
@@ -22,11 +32,30 @@ public:
     Allocation& operator=(Allocation&&);
 
     vk::Result flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
-    vk::Result  withMap(std::function<void(void*)> func, VkDeviceSize offset = 0);
+    template<typename F>
+    vk::Result withMap(F&& func, VkDeviceSize offset = 0)
+    {
+        void *pData;
+        const auto ret = vmaMapMemory(parent, handle, &pData);
+        CallCounter::Add(CallCounter::Call::MapMemory);
+        if (!ret)
+        {
+            pData = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pData) + offset);
+            func(pData);
+            vmaUnmapMemory(parent, handle);
+            CallCounter::Add(CallCounter::Call::UnmapMemory);
+        }
+        return vk::Result(ret);
+    }
+
+private:
+    void free();
 
 private:
     VmaAllocator parent;
     VmaAllocation handle;
+    TagStatistics *pTag;
+    VkDeviceSize size;
 };
 
 }
\ No newline at end of file
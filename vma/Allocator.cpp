@@ -1,10 +1,15 @@
 #include "Allocator.hpp"
 
+#include <cstring>
+
 namespace vma
 {
 
+// Allocations without a tag, or beyond MAX_TAGS distinct tags
+constexpr auto UNTAGGED = "Other";
+
 Allocator::Allocator()
-    :handle(nullptr)
+    :handle(nullptr), pAllocationCallbacks(nullptr), tags{}, tagCount(0)
 {
     
 }
@@ -14,14 +19,15 @@ Allocator::~Allocator()
     vmaDestroyAllocator(handle);
 }
 
-std::pair<vk::UniqueBuffer, Allocation> Allocator::createBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags)
+std::pair<vk::UniqueBuffer, Allocation> Allocator::createBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags, const char *pTag)
 {
     VmaAllocatorInfo allocatorInfo;
     vmaGetAllocatorInfo(handle, &allocatorInfo);
 
     VmaAllocationCreateInfo bufferAllocationInfo = { };
-    bufferAllocationInfo.flags = flags;
+    bufferAllocationInfo.flags = flags | (pTag ? VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT : 0);
     bufferAllocationInfo.usage = memoryUsage;
+    bufferAllocationInfo.pUserData = const_cast<char *>(pTag);
 
     VkBuffer buffer;
     VmaAllocation raw;
@@ -31,17 +37,18 @@ std::pair<vk::UniqueBuffer, Allocation> Allocator::createBuffer(const VkBufferCr
     {
         vk::throwResultException(vk::Result(result), "Allocator::createBuffer");
     }
-    return {vk::UniqueBuffer{buffer, {allocatorInfo.device}}, Allocation{handle, raw}};
+    return {vk::UniqueBuffer{buffer, {allocatorInfo.device, pAllocationCallbacks}}, create_allocation(raw, pTag)};
 }
 
-std::pair<vk::UniqueImage, Allocation> Allocator::createImage(const VkImageCreateInfo& imageCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags)
+std::pair<vk::UniqueImage, Allocation> Allocator::createImage(const VkImageCreateInfo& imageCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags, const char *pTag)
 {
     VmaAllocatorInfo allocatorInfo;
     vmaGetAllocatorInfo(handle, &allocatorInfo);
 
     VmaAllocationCreateInfo imageAllocationInfo = { };
-    imageAllocationInfo.flags = flags;
+    imageAllocationInfo.flags = flags | (pTag ? VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT : 0);
     imageAllocationInfo.usage = memoryUsage;
+    imageAllocationInfo.pUserData = const_cast<char *>(pTag);
 
     VkImage image;
     VmaAllocation raw;
@@ -50,12 +57,16 @@ std::pair<vk::UniqueImage, Allocation> Allocator::createImage(const VkImageCreat
     {
         vk::throwResultException(vk::Result(result), "Allocator::createImage");
     }
-    return {vk::UniqueImage{image, {allocatorInfo.device}}, Allocation{handle, raw}};
+    return {vk::UniqueImage{image, {allocatorInfo.device, pAllocationCallbacks}}, create_allocation(raw, pTag)};
 }
 
-vk::Result Allocator::init(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t apiVersion)
+vk::Result Allocator::init(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t apiVersion, const vk::AllocationCallbacks *pAllocationCallbacks, VmaAllocatorCreateFlags flags)
 {
+    this->pAllocationCallbacks = pAllocationCallbacks;
+
     VmaAllocatorCreateInfo allocatorCreateInfo = { };
+    allocatorCreateInfo.flags = flags;
+    allocatorCreateInfo.pAllocationCallbacks = reinterpret_cast<const VkAllocationCallbacks *>(pAllocationCallbacks);
     allocatorCreateInfo.physicalDevice = physicalDevice;
     allocatorCreateInfo.device = device;
     allocatorCreateInfo.instance = instance;
@@ -64,4 +75,75 @@ vk::Result Allocator::init(vk::Instance instance, vk::PhysicalDevice physicalDev
     return vk::Result(vmaCreateAllocator(&allocatorCreateInfo, &handle));
 }
 
+void Allocator::setCurrentFrameIndex(uint32_t frameIndex)
+{
+    vmaSetCurrentFrameIndex(handle, frameIndex);
+}
+
+uint32_t Allocator::getBudgets(std::array<VmaBudget, VK_MAX_MEMORY_HEAPS>& budgets) const
+{
+    const VkPhysicalDeviceMemoryProperties *pMemoryProperties;
+    vmaGetMemoryProperties(handle, &pMemoryProperties);
+    vmaGetBudget(handle, budgets.data());
+    return pMemoryProperties->memoryHeapCount;
+}
+
+vk::ArrayProxy<const TagStatistics> Allocator::tagStatistics() const
+{
+    return {tagCount.load(std::memory_order_acquire), tags.data()};
+}
+
+std::string Allocator::buildStatsString(bool detailed) const
+{
+    char *pStatsString;
+    vmaBuildStatsString(handle, &pStatsString, detailed);
+    std::string ret(pStatsString);
+    vmaFreeStatsString(handle, pStatsString);
+    return ret;
+}
+
+TagStatistics *Allocator::find_tag(const char *pName)
+{
+    std::lock_guard lock(tagMutex);
+    const auto count = tagCount.load(std::memory_order_relaxed);
+    const auto lookup = [this, count](const char *pName) -> TagStatistics * {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!strcmp(tags[i].pName, pName))
+            {
+                return &tags[i];
+            }
+        }
+        return nullptr;
+    };
+
+    pName = pName ? pName : UNTAGGED;
+    if (const auto pTag = lookup(pName))
+    {
+        return pTag;
+    }
+
+    // The last slot is kept for UNTAGGED, which also takes the tags that don't fit
+    if (count >= MAX_TAGS - 1 && pName != UNTAGGED)
+    {
+        pName = UNTAGGED;
+        if (const auto pTag = lookup(pName))
+        {
+            return pTag;
+        }
+    }
+
+    // Published by the count, so readers never see a slot without its name
+    tags[count].pName = pName;
+    tagCount.store(count + 1, std::memory_order_release);
+    return &tags[count];
+}
+
+Allocation Allocator::create_allocation(VmaAllocation raw, const char *pTag)
+{
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(handle, raw, &allocationInfo);
+    return Allocation{handle, raw, find_tag(pTag), allocationInfo.size};
+}
+
 }
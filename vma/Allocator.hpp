@@ -2,12 +2,18 @@
 
 #include "Allocation.hpp"
 
+#include <array>
+#include <mutex>
+#include <string>
+
 namespace vma
 {
 
 class Allocator
 {
 public:
+    static constexpr size_t MAX_TAGS = 16;
+
     Allocator();
     Allocator(const Allocator&) = delete;
     Allocator(Allocator&&);
@@ -16,12 +22,32 @@ public:
     Allocator& operator=(const Allocator&) = delete;
     Allocator& operator=(Allocator&&);
 
-    std::pair<vk::UniqueBuffer, Allocation> createBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags = 0);
-    std::pair<vk::UniqueImage, Allocation> createImage(const VkImageCreateInfo& imageCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags = 0);
-    vk::Result init(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t apiVersion);
+    // pTag names the owner of the allocation, it must outlive the allocator and
+    // also shows up in the stats string
+    std::pair<vk::UniqueBuffer, Allocation> createBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags = 0, const char *pTag = nullptr);
+    std::pair<vk::UniqueImage, Allocation> createImage(const VkImageCreateInfo& imageCreateInfo, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags = 0, const char *pTag = nullptr);
+    vk::Result init(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t apiVersion, const vk::AllocationCallbacks *pAllocationCallbacks = nullptr, VmaAllocatorCreateFlags flags = 0);
+
+    // Budgets are refreshed from VK_EXT_memory_budget here, so call it once per frame
+    void setCurrentFrameIndex(uint32_t frameIndex);
+    // Returns the number of heaps
+    uint32_t getBudgets(std::array<VmaBudget, VK_MAX_MEMORY_HEAPS>& budgets) const;
+    vk::ArrayProxy<const TagStatistics> tagStatistics() const;
+    // JSON, see vmaBuildStatsString
+    std::string buildStatsString(bool detailed) const;
+
+private:
+    TagStatistics *find_tag(const char *pName);
+    Allocation create_allocation(VmaAllocation raw, const char *pTag);
 
 private:
     VmaAllocator handle;
+    // Buffers and images are destroyed with the callbacks VMA created them with
+    const vk::AllocationCallbacks *pAllocationCallbacks;
+
+    std::mutex tagMutex;
+    std::array<TagStatistics, MAX_TAGS> tags;
+    std::atomic<uint32_t> tagCount;
 };
 
 }